@@ -245,6 +245,7 @@ module design_top
   // Simple AXI-Lite slave accepting one write/read at a time
   // Write channel bookkeeping
   logic        wr_aw_captured, wr_w_captured;
+  logic        wr_aw_pending;   // AW written since the last W beat, sent once per burst
   logic [15:0] wr_addr_q;
   logic [31:0] wr_data_q;
 
@@ -262,6 +263,7 @@ module design_top
     if (!rst_125mhz_n) begin
       wr_aw_captured <= 1'b0;
       wr_w_captured  <= 1'b0;
+      wr_aw_pending  <= 1'b0;
       wr_addr_q      <= '0;
       wr_data_q      <= '0;
       axil_bvalid_m  <= 1'b0;
@@ -306,6 +308,7 @@ module design_top
               if (i == LOOP_TOP_AXI_AW - 1) begin
                 if_axi_wr_aw_dat[49:32] <= wr_data_q[17:0];
                 if_axi_wr_aw_vld <= 1'b0;
+                wr_aw_pending <= 1'b1;
                 axi_ready <= 1'b1;
               end
               else
@@ -327,7 +330,8 @@ module design_top
               if (i == LOOP_TOP_AXI_W - 1) begin
                 if_axi_wr_w_dat[144:128] <= wr_data_q[16:0];
                 if_axi_wr_w_vld <= 1'b1;
-                if_axi_wr_aw_vld <= 1'b1;
+                if_axi_wr_aw_vld <= wr_aw_pending;
+                wr_aw_pending <= 1'b0;
                 axi_ready <= 1'b0;
               end
               else
@@ -361,6 +365,9 @@ module design_top
 
       if (if_axi_wr_w_vld && if_axi_wr_w_rdy) begin
         if_axi_wr_w_vld <= 1'b0;
+        // W = {strobe[144:129], last[128], data[127:0]}; only the last beat gets a B
+        if (!if_axi_wr_w_dat[128])
+          axi_ready <= 1'b1;
       end
 
       if (if_axi_wr_b_vld && if_axi_wr_b_rdy) begin
@@ -88,7 +88,7 @@ int top_write(int bar_handle, const AxiWriteCommand* write_command) {
     transfer_data[1] = write_command->data[1];
     transfer_data[2] = write_command->data[2];
     transfer_data[3] = write_command->data[3];
-    transfer_data[4] = 0x1FFFF; // Strobe
+    transfer_data[4] = TOP_AXI_W_STROBE | TOP_AXI_W_LAST; // single beat
 
     for (int i = 0; i < LOOP_TOP_AXI_W; i++) {
         if (ocl_wr32(bar_handle, ADDR_TOP_AXI_W_START + i * 4, transfer_data[i])) {
@@ -98,6 +98,77 @@ int top_write(int bar_handle, const AxiWriteCommand* write_command) {
     return 0;
 }
 
+/**
+ * @brief Send an AXI INCR burst write of num_beats 128-bit vectors.
+ *
+ * One AW with len = num_beats - 1, then num_beats W beats with WLAST on the
+ * final one. The RVA converter turns each beat into a write at the next
+ * vector address, so consecutive SRAM entries load back to back.
+ * num_beats must be 1..TOP_AXI_MAX_BURST and must not cross a 4KB boundary.
+ */
+int top_write_burst(int bar_handle, uint32_t addr, const uint32_t (*data)[4], int num_beats) {
+    if (num_beats < 1 || num_beats > TOP_AXI_MAX_BURST) {
+        fprintf(stderr, "ERROR: invalid burst length %d at addr=0x%08X\n", num_beats, addr);
+        return 1;
+    }
+
+    uint64_t transfer_addr_full = ((uint64_t)addr << 10);
+    uint32_t transfer_addr[LOOP_TOP_AXI_AW] = {0};
+
+    transfer_addr[0] = transfer_addr_full & 0xFFFFFFFF;
+    transfer_addr[1] = ((transfer_addr_full >> 32) & 0x3FF) |
+                       ((uint32_t)(num_beats - 1) << TOP_AXI_AW_LEN_SHIFT);
+
+    // Write address to AW channel
+    for (int i = 0; i < LOOP_TOP_AXI_AW; i++) {
+        if (ocl_wr32(bar_handle, ADDR_TOP_AXI_AW_START + i * 4, transfer_addr[i])) {
+            return 1;
+        }
+    }
+
+    usleep(10); // Small delay
+
+    // Write data beats to W channel
+    for (int beat = 0; beat < num_beats; beat++) {
+        uint32_t transfer_data[LOOP_TOP_AXI_W] = {0};
+        transfer_data[0] = data[beat][0];
+        transfer_data[1] = data[beat][1];
+        transfer_data[2] = data[beat][2];
+        transfer_data[3] = data[beat][3];
+        transfer_data[4] = TOP_AXI_W_STROBE | ((beat == num_beats - 1) ? TOP_AXI_W_LAST : 0);
+
+        for (int i = 0; i < LOOP_TOP_AXI_W; i++) {
+            if (ocl_wr32(bar_handle, ADDR_TOP_AXI_W_START + i * 4, transfer_data[i])) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Load num_vectors consecutive 128-bit vectors starting at addr.
+ *
+ * Splits the transfer into the longest legal bursts (max length, no 4KB
+ * crossing), e.g. a whole layer of PECore weights in region 0x5/0xB.
+ */
+int top_write_bulk(int bar_handle, uint32_t addr, const uint32_t (*data)[4], int num_vectors) {
+    while (num_vectors > 0) {
+        int to_boundary = (TOP_AXI_BURST_BOUNDARY - (addr % TOP_AXI_BURST_BOUNDARY)) / TOP_AXI_BEAT_BYTES;
+        int num_beats = num_vectors;
+        if (num_beats > TOP_AXI_MAX_BURST) num_beats = TOP_AXI_MAX_BURST;
+        if (num_beats > to_boundary) num_beats = to_boundary;
+
+        if (top_write_burst(bar_handle, addr, data, num_beats)) {
+            return 1;
+        }
+        addr        += num_beats * TOP_AXI_BEAT_BYTES;
+        data        += num_beats;
+        num_vectors -= num_beats;
+        usleep(10);
+    }
+    return 0;
+}
 
 /**
  * @brief Send an AXI read command and retrieve data from the FPGA.
@@ -184,24 +255,29 @@ int main(int argc, char** argv) {
   // ========================================================================= 
   printf("\n---- Running AXI Write/Read Test ----\n");
 
+  // PE weights (region 0x5), loaded as a single burst
+  const uint32_t weight_addr = 0x34500000;
+  const uint32_t weight_data[][4] = {
+      {0x88E1D68C, 0x6BD421D7, 0x5C7F3202, 0xC7427867},
+      {0x5EC23966, 0xA174272E, 0x21E7A2FD, 0xD0319B6C},
+      {0x178B1B85, 0xA331DDE2, 0xB8E9DD33, 0x5781547C},
+      {0x8D22BBEB, 0x4E92D920, 0x04BCB961, 0x4C8C4B83},
+      {0xC5BFA479, 0x0DC7A487, 0xA9D9B720, 0x67AD5414},
+      {0x4A09CF2D, 0x0292B32C, 0xD70083F7, 0x69AB46F7},
+      {0x27208FCB, 0xD103A7F4, 0x9B261E3F, 0x161F6574},
+      {0xE1356000, 0xED6A7A4A, 0xB2819ED0, 0xAABCB5EF},
+      {0xA9695EE4, 0xC59C9EC4, 0x5D2D4CDA, 0xF6D7D941},
+      {0x3E0DFD81, 0x7F151973, 0xF78E9E7F, 0x17899ACB},
+      {0x4E3AD635, 0xACC64781, 0x69A343A4, 0xFCFD96D1},
+      {0x58371BA5, 0x8582459D, 0xE065D484, 0x5C0F148D},
+      {0x1E5515A8, 0xA96684FC, 0xB30AE0F6, 0xCC77DBF7},
+      {0xDF439320, 0xC97FD011, 0x13F2CD9D, 0xC5AA4918},
+      {0x2C4EE908, 0x520BE5B5, 0x72129DD4, 0xB8E6F69A},
+      {0xAE2D9CD6, 0x679295D0, 0xDFD4E551, 0x38B305DE},
+  };
+
   AxiWriteCommand write_commands[] = {
       {0x33500000, {0x9EE3E635, 0x584169B2, 0xA0A882BF, 0xD4C04352}},
-      {0x34500000, {0x88E1D68C, 0x6BD421D7, 0x5C7F3202, 0xC7427867}},
-      {0x34500010, {0x5EC23966, 0xA174272E, 0x21E7A2FD, 0xD0319B6C}},
-      {0x34500020, {0x178B1B85, 0xA331DDE2, 0xB8E9DD33, 0x5781547C}},
-      {0x34500030, {0x8D22BBEB, 0x4E92D920, 0x04BCB961, 0x4C8C4B83}},
-      {0x34500040, {0xC5BFA479, 0x0DC7A487, 0xA9D9B720, 0x67AD5414}},
-      {0x34500050, {0x4A09CF2D, 0x0292B32C, 0xD70083F7, 0x69AB46F7}},
-      {0x34500060, {0x27208FCB, 0xD103A7F4, 0x9B261E3F, 0x161F6574}},
-      {0x34500070, {0xE1356000, 0xED6A7A4A, 0xB2819ED0, 0xAABCB5EF}},
-      {0x34500080, {0xA9695EE4, 0xC59C9EC4, 0x5D2D4CDA, 0xF6D7D941}},
-      {0x34500090, {0x3E0DFD81, 0x7F151973, 0xF78E9E7F, 0x17899ACB}},
-      {0x345000A0, {0x4E3AD635, 0xACC64781, 0x69A343A4, 0xFCFD96D1}},
-      {0x345000B0, {0x58371BA5, 0x8582459D, 0xE065D484, 0x5C0F148D}},
-      {0x345000C0, {0x1E5515A8, 0xA96684FC, 0xB30AE0F6, 0xCC77DBF7}},
-      {0x345000D0, {0xDF439320, 0xC97FD011, 0x13F2CD9D, 0xC5AA4918}},
-      {0x345000E0, {0x2C4EE908, 0x520BE5B5, 0x72129DD4, 0xB8E6F69A}},
-      {0x345000F0, {0xAE2D9CD6, 0x679295D0, 0xDFD4E551, 0x38B305DE}},
       {0x34400010, {0x1, 0x101, 0x0, 0x0}},
       {0x34400020, {0x100, 0x0, 0x0, 0x0}},
       {0x34800010, {0x3020001, 0x1, 0x0, 0x0}},
@@ -231,6 +307,12 @@ int main(int argc, char** argv) {
       {0x34600000, {0}, {0x9EE3E635, 0x584169B2, 0xA0A882BF, 0xD4C04352}},
    };
 
+  int num_weight_vectors = sizeof(weight_data) / sizeof(weight_data[0]);
+  if (top_write_bulk(bar_handle, weight_addr, weight_data, num_weight_vectors)) {
+      rc = 1;
+  }
+  usleep(10);
+
   int num_write_commands = sizeof(write_commands) / sizeof(AxiWriteCommand);
   for (int i = 0; i < num_write_commands; i++) {
       if (top_write(bar_handle, &write_commands[i])) {
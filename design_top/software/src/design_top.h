@@ -50,6 +50,14 @@
 // Interrupt (Top to Host)
 #define ADDR_TOP_INTERRUPT 0x570 // Read
 
+// AXI burst (INCR only, see axiCfg in src/include/AxiSpec.h)
+#define TOP_AXI_AW_LEN_SHIFT 10           // AW = {len[7:0], addr[31:0], id[9:0]}, len in word 1
+#define TOP_AXI_W_LAST (1u << 0)          // W = {strobe[144:129], last[128], data[127:0]}
+#define TOP_AXI_W_STROBE (0xFFFFu << 1)   // so word 4 = {strobe[15:0], last}
+#define TOP_AXI_MAX_BURST 256             // axiCfg::maxBurstSize
+#define TOP_AXI_BEAT_BYTES 16             // 128-bit beat
+#define TOP_AXI_BURST_BOUNDARY 4096       // bursts must not cross a 4KB boundary
+
 // FPGA OCL
 #define WIDTH_AXI 32
 #define ADDR_WIDTH_OCL 16
@@ -81,5 +89,7 @@ int ocl_rd32(int bar_handle, uint16_t addr, uint32_t* data);
 // Top-level AXI interface functions
 int top_write(int bar_handle, const AxiWriteCommand* write_command);
 int top_read(int bar_handle, AxiReadCommand* read_command);
+int top_write_burst(int bar_handle, uint32_t addr, const uint32_t (*data)[4], int num_beats);
+int top_write_bulk(int bar_handle, uint32_t addr, const uint32_t (*data)[4], int num_vectors);
 
 #endif // DESIGN_TOP_H
\ No newline at end of file
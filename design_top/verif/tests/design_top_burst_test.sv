@@ -0,0 +1,167 @@
+`include "common_base_test.svh"
+`include "design_top_defines.vh"
+
+bit test_failed = 0;
+
+// Multi-beat AXI INCR burst through the OCL bridge: one AW with len = N-1,
+// N W beats laid out as W = {strobe[144:129], last[128], data[127:0]} (the
+// axi4 WritePayload Marshall order). Checks that the top sees exactly one AW,
+// WLAST only on the final beat, full strobes, and that every beat lands in
+// consecutive PE weight entries.
+module design_top_burst_test();
+import tb_type_defines_pkg::*;
+
+  localparam int kNumBeats = 16;
+
+  typedef struct {
+    logic [31:0] addr;
+    logic [127:0] data;
+    logic [127:0] expected_read_data;
+  } AxiReadCommand;
+
+  task automatic ocl_wr32(input logic [ADDR_WIDTH_OCL - 1 : 0] addr, input logic [WIDTH_AXI - 1:0] data);
+    tb.poke_ocl(.addr(addr), .data(data));
+  endtask
+
+  task automatic ocl_rd32(input logic [ADDR_WIDTH_OCL - 1 : 0] addr, output logic [WIDTH_AXI - 1:0] data);
+    tb.peek_ocl(.addr(addr), .data(data));
+  endtask
+
+  task automatic top_write_burst(input logic [31:0] addr, input logic [127:0] data[kNumBeats]);
+    // AW = {len[7:0], addr[31:0], id[9:0]}
+    logic [49:0] transfer_addr = {8'(kNumBeats - 1), addr, 10'b0};
+
+    for (int i = 0; i < LOOP_TOP_AXI_AW; i++) begin
+        logic [31:0] temp_addr;
+        temp_addr = transfer_addr[i*32 +: 32];
+        if (i == LOOP_TOP_AXI_AW - 1) begin
+          temp_addr = {14'b0, transfer_addr[49:32]};
+        end
+        ocl_wr32(ADDR_TOP_AXI_AW_START + i*4, temp_addr);
+        #10ns;
+    end
+
+    #100ns;
+
+    for (int beat = 0; beat < kNumBeats; beat++) begin
+      logic [144:0] transfer_data = {16'hffff, (beat == kNumBeats - 1), data[beat]};
+      for (int i = 0; i < LOOP_TOP_AXI_W; i++) begin
+          logic [31:0] temp_data;
+          temp_data = transfer_data[i*32 +: 32];
+          if (i == LOOP_TOP_AXI_W - 1) begin
+            temp_data = {15'd0, transfer_data[144:128]};
+          end
+          ocl_wr32(ADDR_TOP_AXI_W_START + i*4, temp_data);
+          #10ns;
+      end
+      #100ns;
+    end
+  endtask
+
+  task automatic top_read(AxiReadCommand read_command);
+    logic [49:0] transfer_addr = {8'b0, read_command.addr, 10'b0};
+    logic [159:0] transfer_data;
+
+    for (int i = 0; i < LOOP_TOP_AXI_AR; i++) begin
+        logic [31:0] temp_addr;
+        temp_addr = transfer_addr[i*32 +: 32];
+        if (i == LOOP_TOP_AXI_AR - 1) begin
+          temp_addr = {18'd0, transfer_addr[49:32]};
+        end
+        ocl_wr32(ADDR_TOP_AXI_AR_START + i*4, temp_addr);
+        #10ns;
+    end
+
+    #100ns;
+
+    for (int i = 0; i < LOOP_TOP_AXI_R; i++) begin
+        logic [31:0] temp_data;
+        ocl_rd32(ADDR_TOP_AXI_R_START + i*4, temp_data);
+        #10ns;
+        transfer_data[i*32 +: 32] = temp_data;
+    end
+    read_command.data = transfer_data[137:10];
+
+    if (read_command.data != read_command.expected_read_data) begin
+      $error(" Read data vs expected data mismatch! Read data = 0x%h, Expected data = 0x%h", read_command.data, read_command.expected_read_data);
+      test_failed = 1'b1;
+    end
+    else begin
+      $display("Read value matches the expected = 0x%h at 0x%h", read_command.data, read_command.addr);
+    end
+  endtask
+
+  // =========================================================================
+  // W/AW monitor at the top module boundary
+  // =========================================================================
+  int num_aw = 0;
+  int num_w  = 0;
+
+  always @(posedge tb.card.fpga.CL.clk_125mhz) begin
+    if (tb.card.fpga.CL.if_axi_wr_aw_vld && tb.card.fpga.CL.if_axi_wr_aw_rdy) begin
+      num_aw++;
+    end
+    if (tb.card.fpga.CL.if_axi_wr_w_vld && tb.card.fpga.CL.if_axi_wr_w_rdy) begin
+      logic last = tb.card.fpga.CL.if_axi_wr_w_dat[128];
+      num_w++;
+      if (last != (num_w == kNumBeats)) begin
+        $error(" WLAST = %b on beat %0d of %0d", last, num_w, kNumBeats);
+        test_failed = 1'b1;
+      end
+      if (tb.card.fpga.CL.if_axi_wr_w_dat[144:129] != 16'hffff) begin
+        $error(" WSTRB = 0x%h on beat %0d", tb.card.fpga.CL.if_axi_wr_w_dat[144:129], num_w);
+        test_failed = 1'b1;
+      end
+    end
+  end
+
+  // =========================================================================
+  // Main Test Sequence
+  // =========================================================================
+  initial begin
+    logic [127:0] burst_data[kNumBeats];
+    AxiReadCommand read_command;
+
+    foreach (burst_data[i]) begin
+      burst_data[i] = {4{32'hB0A50000 + i}};
+    end
+
+    tb.power_up(.clk_recipe_a(ClockRecipe::A0),
+                .clk_recipe_b(ClockRecipe::B0),
+                .clk_recipe_c(ClockRecipe::C0));
+
+    #500ns;
+
+    $display("\n Starting %0d-beat AXI burst...\n", kNumBeats);
+
+    // PE weights (region 0x5), one vector per beat
+    top_write_burst(32'h34500000, burst_data);
+
+    if (num_aw != 1 || num_w != kNumBeats) begin
+      $error(" Burst handshakes: %0d AW (expected 1), %0d W (expected %0d)", num_aw, num_w, kNumBeats);
+      test_failed = 1'b1;
+    end
+
+    foreach (burst_data[i]) begin
+      read_command = '{32'h34500000 + i*16, '0, burst_data[i]};
+      top_read(read_command);
+    end
+
+    #500ns;
+    tb.power_down();
+
+    if (!test_failed)
+      $display("---- TEST PASSED ----");
+    else
+      $display("---- TEST FAILED ----");
+
+    $finish;
+  end
+
+  initial begin
+    #100000ns; // Timeout after 1ms
+    $error("Test timed out!");
+    $finish;
+  end
+
+endmodule
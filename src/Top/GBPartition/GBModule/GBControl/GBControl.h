@@ -99,7 +99,8 @@ class GBControl : public match::Module {
 
   // A. FSM
   enum FSM {
-    IDLE, SEND, SEND2, START, RECV, SENDBACK, SENDBACK2, NEXT
+    IDLE, SEND, SEND2, START, RECV, SENDBACK, SENDBACK2, NEXT,
+    PSEND, PSEND2, PSEND3
   };
   FSM state;                 
   
@@ -107,6 +108,13 @@ class GBControl : public match::Module {
   
   bool is_start;
   GBControlConfig gbcontrol_config;
+
+  // Prefetch (requires PECore input ping-pong): timestep t+1 is streamed
+  // into the PE fill bank once timestep t has produced its first output
+  bool is_recv_data;                    // data_in received for current timestep
+  bool is_prefetched;                   // next timestep already sent to PE
+  NVUINT16 recv_timestep_index;         // timestep the PE is currently computing
+  spec::StreamType prefetch_reg;        // held until PE input accepts it
   
   bool w_axi_rsp, w_done;
   spec::Axi::SubordinateToRVA::Read rva_out_reg;    
@@ -114,6 +122,9 @@ class GBControl : public match::Module {
   void Reset() {
     state = IDLE;
     is_start = 0;
+    is_recv_data = 0;
+    is_prefetched = 0;
+    recv_timestep_index = 0;
     gbcontrol_config.Reset();
     ResetPorts();
   }
@@ -177,6 +188,22 @@ class GBControl : public match::Module {
     }  
   }
   
+  void RecvData() {
+    // receive data from PE and forward it to GB, memory_index_2;
+    spec::StreamType data_in_reg;
+    if (data_in.PopNB(data_in_reg)) {
+      large_req_reg.is_write = 1;
+      large_req_reg.memory_index = gbcontrol_config.memory_index_2;
+      large_req_reg.vector_index = data_in_reg.logical_addr;
+      large_req_reg.timestep_index = recv_timestep_index;
+      large_req_reg.write_data = data_in_reg.data;
+      large_req.Push(large_req_reg);
+      is_recv_data = 1;
+
+      CDCOUT(sc_time_stamp() << name() << " CASE RECV " << endl, kDebugLevel);
+    }
+  }
+
   void RunFSM() {
     switch (state) {
       case IDLE: {
@@ -219,24 +246,14 @@ class GBControl : public match::Module {
       }
       case START: {
         // send PE start 
+        recv_timestep_index = gbcontrol_config.GetTimestepIndexGBControl();
+        is_recv_data = 0;
         pe_start.Push(1);
         break;
       }
       case RECV: {
         // wait for Done while recieving data from PE and forward it to GB, memory_index_2;
-        spec::StreamType data_in_reg;        
-        if (data_in.PopNB(data_in_reg)) {
-          NVUINT3  memory_index = gbcontrol_config.memory_index_2;
-          NVUINT16 timestep_index = gbcontrol_config.GetTimestepIndexGBControl();
-          large_req_reg.is_write = 1;
-          large_req_reg.memory_index = memory_index;
-          large_req_reg.vector_index = data_in_reg.logical_addr;
-          large_req_reg.timestep_index = timestep_index;
-          large_req_reg.write_data = data_in_reg.data;
-          large_req.Push(large_req_reg);
-
-          CDCOUT(sc_time_stamp() << name() << " CASE RECV " << endl, kDebugLevel);
-        }
+        RecvData();
         break;
       }
       case SENDBACK: { // data_out_reg.index = 1 for hidden state logical memory in PECore
@@ -271,6 +288,31 @@ class GBControl : public match::Module {
         CDCOUT(sc_time_stamp() << name() << " CASE NEXT " << endl, kDebugLevel);
         break;
       }
+      case PSEND: {
+        // Same as SEND, timestep counter already points to the next timestep
+        NVUINT16 timestep_index = gbcontrol_config.GetTimestepIndexGBControl();
+        if (gbcontrol_config.mode == 1 || gbcontrol_config.mode == 2) timestep_index = timestep_index >> 1;
+
+        large_req_reg.is_write = 0;
+        large_req_reg.memory_index = gbcontrol_config.memory_index_1;
+        large_req_reg.vector_index = gbcontrol_config.GetVectorIndex();
+        large_req_reg.timestep_index = timestep_index;
+        large_req.Push(large_req_reg);
+        break;
+      }
+      case PSEND2: {
+        large_rsp_reg = large_rsp.Pop();
+        prefetch_reg.data = large_rsp_reg.read_vector[0];
+        prefetch_reg.index = x_index;
+        prefetch_reg.logical_addr = gbcontrol_config.GetVectorIndex();
+        break;
+      }
+      case PSEND3: {
+        // PE may be blocked on its output, keep draining data_in while
+        // the prefetch vector waits
+        RecvData();
+        break;
+      }
       default: {
         break;
       }
@@ -330,6 +372,14 @@ class GBControl : public match::Module {
             next_state = NEXT;
           }
         }
+        else if (gbcontrol_config.is_prefetch && !gbcontrol_config.is_rnn &&
+                 is_recv_data && !is_prefetched && !gbcontrol_config.IsLastTimestep()) {
+          // PE has swapped its input bank, start filling the other one
+          bool is_end = 0;
+          gbcontrol_config.UpdateTimestepCounter(is_end);
+          is_prefetched = 1;
+          next_state = PSEND;
+        }
         else {
           next_state = RECV;
         }
@@ -354,16 +404,42 @@ class GBControl : public match::Module {
       case NEXT: {
         // Move to next timestep
         bool is_end = 0;
-        gbcontrol_config.UpdateTimestepCounter(is_end);
-        if (is_end) {
-          // Pushdone 
-          is_start = 0;
-          next_state = IDLE;
-          CDCOUT(sc_time_stamp()  << " GBControl: " << name() << " Finish" << endl, kDebugLevel);
-          done.Push(1);    
+        if (is_prefetched) {
+          // counter advanced and data sent during prefetch
+          is_prefetched = 0;
+          next_state = START;
         }
         else {
-          next_state = SEND;
+          gbcontrol_config.UpdateTimestepCounter(is_end);
+          if (is_end) {
+            // Pushdone 
+            is_start = 0;
+            next_state = IDLE;
+            CDCOUT(sc_time_stamp()  << " GBControl: " << name() << " Finish" << endl, kDebugLevel);
+            done.Push(1);    
+          }
+          else {
+            next_state = SEND;
+          }
+        }
+        break;
+      }
+      case PSEND: {
+        next_state = PSEND2;
+        break;
+      }
+      case PSEND2: {
+        next_state = PSEND3;
+        break;
+      }
+      case PSEND3: {
+        if (data_out.PushNB(prefetch_reg)) {
+          bool is_end = 0;
+          gbcontrol_config.UpdateVectorCounter(0, is_end);
+          next_state = is_end ? RECV : PSEND;
+        }
+        else {
+          next_state = PSEND3;
         }
         break;
       }
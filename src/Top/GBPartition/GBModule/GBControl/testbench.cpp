@@ -223,6 +223,212 @@ SC_MODULE(Dest) {
 
 
 
+// Directed prefetch case on its own GBControl instance. A GB memory model
+// answers every read with (timestep, vector, memory) in lanes 0-2 and checks
+// every write, a PE model checks what arrives on data_out around pe_start
+// and pe_done. Run 0 (is_prefetch) streams t+1 while t computes and holds
+// data_out back while it returns an output, so that output is drained in
+// PSEND3; run 1 (is_rnn) must keep the SEND/SENDBACK path.
+bool prefetch_done = false;
+
+SC_MODULE(PrefetchHarness) {
+  sc_in<bool> clk;
+  sc_in<bool> rst;
+  Connections::Out<spec::Axi::SubordinateToRVA::Write> rva_in;
+  Connections::In<spec::Axi::SubordinateToRVA::Read> rva_out;
+  Connections::Out<bool> start;
+  Connections::In<bool> done;
+  Connections::In<spec::GB::Large::DataReq>      large_req;
+  Connections::Out<spec::GB::Large::DataRsp<1>>  large_rsp;
+  Connections::In<spec::StreamType>  data_out;
+  Connections::Out<spec::StreamType> data_in;
+  Connections::In<bool> pe_start;
+  Connections::Out<bool> pe_done;
+
+  static const int kMemIn = 1, kMemOut = 2, kNumVecIn = 2, kNumVecOut = 2;
+  int num_timestep;
+  int num_writes;
+
+  SC_CTOR(PrefetchHarness) {
+    SC_THREAD(run_pe);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+    SC_THREAD(run_mem);
+    sensitive << clk.pos();
+    async_reset_signal_is(rst, false);
+  }
+
+  void error(const std::string& msg) {
+    SC_REPORT_ERROR("GBControl prefetch", msg.c_str());
+  }
+
+  void run_mem() {
+    large_req.Reset();
+    large_rsp.Reset();
+    num_writes = 0;
+    wait();
+    while (1) {
+      spec::GB::Large::DataReq req = large_req.Pop();
+      if (req.is_write) {
+        // PE outputs carry their own timestep and vector in lanes 0-1
+        num_writes++;
+        if (req.memory_index != kMemOut ||
+            req.timestep_index != (unsigned)req.write_data[0].to_int() ||
+            req.vector_index != (unsigned)req.write_data[1].to_int()) {
+          std::ostringstream msg;
+          msg << "output t" << req.write_data[0].to_int() << " v" << req.write_data[1].to_int()
+              << " written at t" << req.timestep_index << " v" << req.vector_index;
+          error(msg.str());
+        }
+      }
+      else {
+        if (req.memory_index == kMemIn && req.timestep_index >= (unsigned)num_timestep) {
+          error("input read past the last timestep");
+        }
+        spec::GB::Large::DataRsp<1> rsp;
+        rsp.read_vector[0][0] = req.timestep_index;
+        rsp.read_vector[0][1] = req.vector_index;
+        rsp.read_vector[0][2] = req.memory_index;
+        large_rsp.Push(rsp);
+      }
+      wait();
+    }
+  }
+
+  // Pop one data_out vector within a bounded wait
+  bool pop_out(spec::StreamType& out, int timeout = 200) {
+    for (int i = 0; i < timeout; i++) {
+      if (data_out.PopNB(out)) return true;
+      wait();
+    }
+    return false;
+  }
+
+  // num_vec vectors of (memory, timestep) on stream index, in vector order
+  bool check_out(int index, int mem, int t, int num_vec, const std::string& what) {
+    for (int v = 0; v < num_vec; v++) {
+      spec::StreamType out;
+      if (!pop_out(out)) {
+        error(what + ": data_out timed out");
+        return false;
+      }
+      if (out.index != index || out.logical_addr != v || out.data[0].to_int() != t ||
+          out.data[1].to_int() != v || out.data[2].to_int() != mem) {
+        std::ostringstream msg;
+        msg << what << ": got index " << out.index << " t" << out.data[0].to_int()
+            << " v" << out.data[1].to_int() << " mem " << out.data[2].to_int()
+            << ", expected t" << t << " v" << v;
+        error(msg.str());
+      }
+    }
+    return true;
+  }
+
+  void push_output(int t, int v) {
+    spec::StreamType out;
+    out.data = 0;
+    out.data[0] = t;
+    out.data[1] = v;
+    out.logical_addr = v;
+    data_in.Push(out);
+    wait();
+  }
+
+  void config(bool is_rnn, bool is_prefetch) {
+    spec::Axi::SubordinateToRVA::Write cmd;
+    cmd.rw = 1;
+    cmd.addr = 0x700010;
+    cmd.data = 0;
+    cmd.data.set_slc(0,  (NVUINT1)1);
+    cmd.data.set_slc(16, (NVUINT1)is_rnn);
+    cmd.data.set_slc(24, (NVUINT1)is_prefetch);
+    cmd.data.set_slc(32, (NVUINT3)kMemIn);
+    cmd.data.set_slc(40, (NVUINT3)kMemOut);
+    cmd.data.set_slc(48, (NVUINT8)kNumVecIn);
+    cmd.data.set_slc(56, (NVUINT8)kNumVecOut);
+    cmd.data.set_slc(64, (NVUINT16)num_timestep);
+    rva_in.Push(cmd);
+    wait(2);
+    start.Push(1);
+    wait();
+  }
+
+  // Timestep 0 is sent before the first pe_start, every later one must have
+  // arrived before the previous pe_done
+  bool test_prefetch() {
+    num_timestep = 3;
+    num_writes = 0;
+    config(0, 1);
+    if (!check_out(0, kMemIn, 0, kNumVecIn, "timestep 0")) return false;
+    for (int t = 0; t < num_timestep; t++) {
+      pe_start.Pop();
+      spec::StreamType extra;
+      if (data_out.PopNB(extra)) error("data_out after pe_start, prefetch was sent twice");
+      push_output(t, 0);
+      if (t < num_timestep - 1) {
+        // data_out held back: this output is drained in PSEND3
+        wait(10);
+        push_output(t, 1);
+        std::ostringstream what;
+        what << "prefetch of timestep " << t + 1;
+        if (!check_out(0, kMemIn, t + 1, kNumVecIn, what.str())) return false;
+      }
+      else {
+        push_output(t, 1);
+        spec::StreamType out;
+        if (pop_out(out, 30)) error("prefetch on the last timestep");
+      }
+      pe_done.Push(1);
+      wait();
+    }
+    done.Pop();
+    wait(10);
+    if (num_writes != num_timestep * kNumVecOut) error("prefetch run lost outputs");
+    return true;
+  }
+
+  // is_rnn takes precedence over is_prefetch: x, pe_start, outputs, pe_done,
+  // then h read back from the output memory for every timestep
+  bool test_rnn() {
+    num_timestep = 2;
+    num_writes = 0;
+    config(1, 1);
+    for (int t = 0; t < num_timestep; t++) {
+      std::ostringstream what;
+      what << "rnn x of timestep " << t;
+      if (!check_out(0, kMemIn, t, kNumVecIn, what.str())) return false;
+      pe_start.Pop();
+      for (int v = 0; v < kNumVecOut; v++) push_output(t, v);
+      spec::StreamType out;
+      if (pop_out(out, 30)) error("rnn run prefetched before pe_done");
+      pe_done.Push(1);
+      wait();
+      if (!check_out(1, kMemOut, t, kNumVecOut, "rnn sendback h")) return false;
+    }
+    done.Pop();
+    wait(10);
+    if (num_writes != num_timestep * kNumVecOut) error("rnn run lost outputs");
+    return true;
+  }
+
+  void run_pe() {
+    rva_in.Reset();
+    rva_out.Reset();
+    start.Reset();
+    done.Reset();
+    data_out.Reset();
+    data_in.Reset();
+    pe_start.Reset();
+    pe_done.Reset();
+    num_timestep = 1;
+    wait(10);
+    if (test_prefetch()) test_rnn();
+    cout << sc_time_stamp() << " GBControl prefetch case finished" << endl;
+    prefetch_done = true;
+    while (1) wait();
+  }
+};
+
 SC_MODULE(testbench) {
   SC_HAS_PROCESS(testbench);
 	sc_clock clk;
@@ -245,6 +451,20 @@ SC_MODULE(testbench) {
   NVHLS_DESIGN(GBControl) dut;
   Source  source;
   Dest    dest;
+
+  Connections::Combinational<spec::Axi::SubordinateToRVA::Write> p_rva_in;
+  Connections::Combinational<spec::Axi::SubordinateToRVA::Read> p_rva_out;
+  Connections::Combinational<bool> p_start;
+  Connections::Combinational<bool> p_done;
+  Connections::Combinational<spec::GB::Large::DataReq>      p_large_req;
+  Connections::Combinational<spec::GB::Large::DataRsp<1>>    p_large_rsp;
+  Connections::Combinational<spec::StreamType> p_data_out;
+  Connections::Combinational<spec::StreamType> p_data_in;
+  Connections::Combinational<bool> p_pe_start;
+  Connections::Combinational<bool> p_pe_done;
+
+  NVHLS_DESIGN(GBControl) dut_pf;
+  PrefetchHarness pf;
   
   testbench(sc_module_name name)
   : sc_module(name),
@@ -252,7 +472,9 @@ SC_MODULE(testbench) {
     rst("rst"),
     dut("dut"),
     source("source"),
-    dest("dest")
+    dest("dest"),
+    dut_pf("dut_pf"),
+    pf("pf")
   {
     dut.clk(clk);
     dut.rst(rst);
@@ -282,6 +504,32 @@ SC_MODULE(testbench) {
       dest.large_req(large_req);
       dest.data_out(data_out);
       dest.pe_start(pe_start);
+
+    dut_pf.clk(clk);
+    dut_pf.rst(rst);
+    dut_pf.rva_in(p_rva_in);
+    dut_pf.rva_out(p_rva_out);
+    dut_pf.start(p_start);
+    dut_pf.done(p_done);
+    dut_pf.large_req(p_large_req);
+    dut_pf.large_rsp(p_large_rsp);
+    dut_pf.data_out(p_data_out);
+    dut_pf.data_in(p_data_in);
+    dut_pf.pe_start(p_pe_start);
+    dut_pf.pe_done(p_pe_done);
+
+    pf.clk(clk);
+    pf.rst(rst);
+    pf.rva_in(p_rva_in);
+    pf.rva_out(p_rva_out);
+    pf.start(p_start);
+    pf.done(p_done);
+    pf.large_req(p_large_req);
+    pf.large_rsp(p_large_rsp);
+    pf.data_out(p_data_out);
+    pf.data_in(p_data_in);
+    pf.pe_start(p_pe_start);
+    pf.pe_done(p_pe_done);
     //testset();
     			
     SC_THREAD(run);
@@ -318,6 +566,8 @@ SC_MODULE(testbench) {
     rst.write(true);
     std::cout << "@" << sc_time_stamp() <<" De-Asserting reset" << std::endl;
     wait(1000, SC_NS );
+    for (int i = 0; i < 1000 && !prefetch_done; i++) wait(10, SC_NS);
+    if (!prefetch_done) SC_REPORT_ERROR("GBControl prefetch", "stalled");
     std::cout << "@" << sc_time_stamp() <<" sc_stop" << std::endl;
     sc_stop();
   }
@@ -24,7 +24,16 @@
 #include "NMPSpec.h"
 
 /**
- * @brief NMP module definition performing RMSNorm or Softmax.
+ * @brief NMP module definition performing RMSNorm, LayerNorm or Softmax.
+ *
+ * With is_row set, softmax spans all num_vector_1 vectors of a timestep:
+ * a first pass keeps a running max and a rescaled sum of exponentials
+ * (online softmax), a second pass rereads the row and writes it normalized.
+ * RMSNorm/LayerNorm likewise gather sum and sum of squares over the row
+ * first; with is_affine each normalized vector is scaled by gamma and
+ * shifted by beta read from memory_index_2.
+ * A config with mode 3-7 is written back with is_valid cleared and its
+ * start pulse is dropped, like a start without a valid config.
  */
 class NMP : public match::Module {
   static const int kDebugLevel = 3;
@@ -56,10 +65,14 @@ public:
     RMS_SUMSQ,    // RMSNorm: compute sum of squares
     RMS_SQRT,     // RMSNorm: compute sqrt and reciprocal
     RMS_NORM,     // RMSNorm: apply normalization
+    PARAM_PRE,    // Norms: request gamma or beta for the current vector
+    PARAM_READ,   // Norms: wait for gamma or beta
     SOFTMAX_MAX,  // Softmax: find maximum value
     SOFTMAX_EXP,  // Softmax: compute exp(x - max)
     SOFTMAX_SUM,  // Softmax: compute reciprocal of sum
     SOFTMAX_NORM, // Softmax: normalize by reciprocal
+    SOFTMAX_ACC,  // Row softmax: rescale running sum to the new max and add
+    ROW_NEXT,     // Row modes: advance through the statistics pass
     WRITE,
     NEXT,
     FIN
@@ -85,8 +98,13 @@ public:
   /** Outgoing vector payload after computation */
   spec::VectorType write_data;
 
-  /** opcode mapping: 0 -> RMSNorm, 1 -> Softmax */
+  /** opcode mapping: 0 -> RMSNorm, 1 -> Softmax, 2 -> LayerNorm */
   NVUINT1 op_softmax;
+  NVUINT1 op_layernorm;
+  /** Norm parameter being fetched: 0 -> gamma, 1 -> beta */
+  NVUINT1 param_select;
+  /** Row modes: 0 while gathering row statistics, 1 while normalizing */
+  bool is_row_norm;
 
   // ===========================================================================
   // Fixed-point computation state
@@ -99,12 +117,21 @@ public:
   spec::NMP::UnsignedFixedType exp_values[spec::kVectorSize];
   /** Maximum value for stable softmax */
   spec::NMP::FixedType max_value;
+  /** Row softmax: running max before the current vector */
+  spec::NMP::FixedType prev_max;
   /** Sum of exponentials for softmax normalization */
   spec::NMP::UnsignedAccumType sum_exp;
   /** Reciprocal of sum for division */
   spec::NMP::AccumType sum_exp_reciprocal;
+  /** Sum for LayerNorm mean */
+  spec::NMP::RowAccumType sum_x;
   /** Sum of squares for RMSNorm */
-  spec::NMP::AccumType sum_sq;
+  spec::NMP::RowAccumType sum_sq;
+  /** LayerNorm mean, 0 for RMSNorm */
+  spec::NMP::AccumType mean_value;
+  /** Per-channel scale and shift for the current vector */
+  spec::NMP::FixedType gamma_fixed[spec::kVectorSize];
+  spec::NMP::FixedType beta_fixed[spec::kVectorSize];
   /** RMS reciprocal for normalization */
   spec::NMP::AccumType rms_reciprocal;
 
@@ -130,6 +157,7 @@ public:
   void Reset() {
     state     = IDLE;
     is_start  = 0;
+    is_row_norm = 0;
     w_axi_rsp = 0;
     w_done    = 0;
     nmp_config.Reset();
@@ -140,15 +168,21 @@ public:
   /** Reset computation state */
   void ResetCompute() {
     max_value          = spec::kAttentionWordMin;
+    prev_max           = spec::kAttentionWordMin;
     sum_exp            = 0;
     sum_exp_reciprocal = 0;
+    sum_x              = 0;
     sum_sq             = 0;
+    mean_value         = 0;
     rms_reciprocal     = 0;
+    param_select       = 0;
 #pragma hls_unroll yes
     for (int i = 0; i < spec::kVectorSize; i++) {
       input_fixed[i]  = 0;
       output_fixed[i] = 0;
       exp_values[i]   = 0;
+      gamma_fixed[i]  = 1;
+      beta_fixed[i]   = 0;
     }
   } // ResetCompute
 
@@ -206,6 +240,15 @@ public:
     large_req.Push(large_req_reg);
   } // PrepareWriteReq
 
+  /** Prepare GB large-buffer read request for gamma or beta */
+  void PrepareParamReadReq() {
+    large_req_reg.is_write       = 0;
+    large_req_reg.memory_index   = nmp_config.memory_index_2;
+    large_req_reg.vector_index   = nmp_config.GetVectorIndex();
+    large_req_reg.timestep_index = param_select;
+    large_req.Push(large_req_reg);
+  } // PrepareParamReadReq
+
   // ===========================================================================
   // Data Conversion Functions
   // Note that the I/O data is in int8 format, but computation is done
@@ -228,6 +271,23 @@ public:
     }
   } // ConvertInputToFixed
 
+  /**
+   * @brief Convert a gamma or beta vector (int8 Q2.6) to fixed-point format.
+   */
+  void ConvertParamToFixed(const spec::GB::Large::DataRsp<1>& param_rsp) {
+    spec::NMP::ParamFixedType param_fixed = 0;
+#pragma hls_unroll yes
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      NVINTW(spec::kIntWordWidth) signed_param = (NVINTW(spec::kIntWordWidth))param_rsp.read_vector[0][i];
+      param_fixed.set_slc(0, signed_param);
+      if (param_select == 0) {
+        gamma_fixed[i] = param_fixed;
+      } else {
+        beta_fixed[i] = param_fixed;
+      }
+    }
+  } // ConvertParamToFixed
+
   /**
    * @brief Convert fixed-point output back to int for write
    */
@@ -242,25 +302,45 @@ public:
   } // ConvertOutputToInt
 
 
-  /** RMSNorm Step 1 */
+  /** RMSNorm/LayerNorm Step 1, row modes accumulate across vectors */
   void ComputeRMSSumSq() {
 
-    sum_sq = 0;
+    if (!nmp_config.is_row) {
+      sum_x  = 0;
+      sum_sq = 0;
+    }
 #pragma hls_unroll yes
     for (int i = 0; i < spec::kVectorSize; i++) {
       spec::NMP::AccumType sq = input_fixed[i] * input_fixed[i];
+      sum_x  += input_fixed[i];
       sum_sq += sq;
     }
 
   } // ComputeRMSSumSq
 
-  /** RMSNorm Step 2 */
+  /** RMSNorm/LayerNorm Step 2 */
   void ComputeRMSSqrtRecip() {
 
-    // mean = sum_sq / kVectorSize
+    // 1 / number of normalized elements
+    spec::NMP::UnsignedAccumType inv_num = spec::NMP::kInvVectorSize;
+    if (nmp_config.is_row) {
+      spec::NMP::UnsignedAccumType num_elem = nmp_config.num_vector_1 * spec::kVectorSize;
+      ac_math::ac_reciprocal_pwl(num_elem, inv_num);
+    }
+
+    // LayerNorm: var = E[x^2] - E[x]^2, RMSNorm: mean square with mean = 0
+    mean_value = 0;
+    spec::NMP::AccumType mean_sq = 0;
+    if (op_layernorm) {
+      mean_value = sum_x * inv_num;
+      mean_sq    = mean_value * mean_value;
+    }
+    spec::NMP::AccumType var = sum_sq * inv_num - mean_sq;
+    if (var < 0) {
+      var = 0;
+    }
     spec::NMP::UnsignedAccumType rms_sqrt;
-    spec::NMP::UnsignedAccumType mean =
-        sum_sq * spec::NMP::kInvVectorSize + spec::NMP::kEpsilon;
+    spec::NMP::UnsignedAccumType mean = var + spec::NMP::kEpsilon;
     ac_math::ac_sqrt_pwl(mean, rms_sqrt);
 
     // reciprocal: 1 / sqrt(mean + epsilon)
@@ -268,12 +348,17 @@ public:
 
   } // ComputeRMSSqrtRecip
 
-  /** RMSNorm Step 3 */
+  /** RMSNorm/LayerNorm Step 3, gamma/beta are 1/0 unless is_affine */
   void ComputeRMSNormalize() {
 
 #pragma hls_unroll yes
     for (int i = 0; i < spec::kVectorSize; i++) {
-      output_fixed[i] = input_fixed[i] * rms_reciprocal;
+      spec::NMP::FixedType norm = (input_fixed[i] - mean_value) * rms_reciprocal;
+      if (nmp_config.is_affine) {
+        output_fixed[i] = norm * gamma_fixed[i] + beta_fixed[i];
+      } else {
+        output_fixed[i] = norm;
+      }
     }
 
   } // ComputeRMSNormalize
@@ -337,6 +422,57 @@ public:
 
   } // ComputeSoftmaxNormalize
 
+  /** Row Softmax Step 1: fold this vector into the running max */
+  void ComputeSoftmaxRowMax() {
+    spec::NMP::FixedType vec_max = spec::kAttentionWordMin;
+
+#pragma hls_unroll yes
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      if (input_fixed[i] > vec_max) {
+        vec_max = input_fixed[i];
+      }
+    }
+    prev_max = max_value;
+    if (vec_max > max_value) {
+      max_value = vec_max;
+    }
+
+  } // ComputeSoftmaxRowMax
+
+  /** Row Softmax Step 3: sum_exp = sum_exp * exp(prev_max - max) + sum(exp) */
+  void ComputeSoftmaxRowAcc() {
+    spec::NMP::FixedType max_delta = prev_max - max_value;
+    spec::NMP::UnsignedFixedType rescale =
+        ac_math::ac_exp_pwl<spec::NMP::UnsignedFixedType>(max_delta);
+    spec::NMP::UnsignedAccumType vec_sum = 0;
+
+#pragma hls_unroll yes
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      vec_sum += exp_values[i];
+    }
+    sum_exp = sum_exp * rescale + vec_sum;
+
+  } // ComputeSoftmaxRowAcc
+
+  /** Row Softmax Step 4: reciprocal of the whole-row sum */
+  void ComputeSoftmaxRowRecip() {
+    ac_math::ac_reciprocal_pwl(sum_exp, sum_exp_reciprocal);
+  } // ComputeSoftmaxRowRecip
+
+  /** Clear row statistics before the next timestep */
+  void ResetRowStats() {
+    max_value = spec::kAttentionWordMin;
+    prev_max  = spec::kAttentionWordMin;
+    sum_exp   = 0;
+    sum_x     = 0;
+    sum_sq    = 0;
+  } // ResetRowStats
+
+  /** Norms: fetch gamma/beta first when is_affine */
+  FSM NormNextState() const {
+    return nmp_config.is_affine ? PARAM_PRE : RMS_NORM;
+  } // NormNextState
+
   // ===========================================================================
   // Finite State Machine Functions
   // ===========================================================================
@@ -358,15 +494,27 @@ public:
         ComputeRMSNormalize();
         ConvertOutputToInt();
         break;
+      case PARAM_PRE: PrepareParamReadReq(); break;
+      // Parameter reception handled in UpdateFSM
+      case PARAM_READ: break;
 
       // Softmax path
-      case SOFTMAX_MAX: ComputeSoftmaxMax(); break;
+      case SOFTMAX_MAX:
+        if (nmp_config.is_row) ComputeSoftmaxRowMax();
+        else ComputeSoftmaxMax();
+        break;
       case SOFTMAX_EXP: ComputeSoftmaxExp(); break;
-      case SOFTMAX_SUM: ComputeSoftmaxSum(); break;
+      case SOFTMAX_SUM:
+        if (nmp_config.is_row) ComputeSoftmaxRowRecip();
+        else ComputeSoftmaxSum();
+        break;
       case SOFTMAX_NORM:
         ComputeSoftmaxNormalize();
         ConvertOutputToInt();
         break;
+      case SOFTMAX_ACC: ComputeSoftmaxRowAcc(); break;
+      // Counters are advanced in UpdateFSM
+      case ROW_NEXT: break;
 
       // Write results back to GBCore
       case WRITE: PrepareWriteReq(); break;
@@ -397,7 +545,9 @@ public:
         }
         if (is_start) {
           nmp_config.ResetCounter();
+          is_row_norm = 0;
           op_softmax = (nmp_config.mode == 1);
+          op_layernorm = (nmp_config.mode == 2);
           next_state = PRE;
         } else {
           next_state = IDLE;
@@ -414,7 +564,13 @@ public:
         if (large_rsp.PopNB(data_rsp)) {
           large_rsp_reg = data_rsp;
           ConvertInputToFixed();
-          next_state = op_softmax ? SOFTMAX_MAX : RMS_SUMSQ;
+          if (op_softmax) {
+            // Row softmax skips the max on the normalize pass, max is final
+            next_state = (nmp_config.is_row && is_row_norm) ? SOFTMAX_EXP : SOFTMAX_MAX;
+          } else {
+            // Row norms skip straight to normalize on the second pass
+            next_state = (nmp_config.is_row && is_row_norm) ? NormNextState() : RMS_SUMSQ;
+          }
         } else {
           // Keep waiting for data
           next_state = READ;
@@ -423,15 +579,72 @@ public:
       } // READ
 
       // RMSNorm pipeline
-      case RMS_SUMSQ: next_state = RMS_SQRT; break;
-      case RMS_SQRT: next_state = RMS_NORM; break;
+      case RMS_SUMSQ: next_state = nmp_config.is_row ? ROW_NEXT : RMS_SQRT; break;
+      case RMS_SQRT: {
+        if (nmp_config.is_row) {
+          // Row statistics done, reread the row to normalize it
+          is_row_norm = 1;
+          next_state  = PRE;
+        } else {
+          next_state = NormNextState();
+        }
+        break;
+      }
       case RMS_NORM: next_state = WRITE; break;
 
+      // gamma then beta for the current vector
+      case PARAM_PRE: next_state = PARAM_READ; break;
+      case PARAM_READ: {
+        spec::GB::Large::DataRsp<1> param_rsp;
+        if (large_rsp.PopNB(param_rsp)) {
+          ConvertParamToFixed(param_rsp);
+          if (param_select == 0) {
+            param_select = 1;
+            next_state   = PARAM_PRE;
+          } else {
+            param_select = 0;
+            next_state   = RMS_NORM;
+          }
+        } else {
+          next_state = PARAM_READ;
+        }
+        break;
+      } // PARAM_READ
+
       // Softmax pipeline
       case SOFTMAX_MAX: next_state = SOFTMAX_EXP; break;
-      case SOFTMAX_EXP: next_state = SOFTMAX_SUM; break;
-      case SOFTMAX_SUM: next_state = SOFTMAX_NORM; break;
+      case SOFTMAX_EXP: {
+        if (nmp_config.is_row) {
+          next_state = is_row_norm ? SOFTMAX_NORM : SOFTMAX_ACC;
+        } else {
+          next_state = SOFTMAX_SUM;
+        }
+        break;
+      }
+      case SOFTMAX_SUM: {
+        if (nmp_config.is_row) {
+          // Row statistics done, reread the row to normalize it
+          is_row_norm = 1;
+          next_state  = PRE;
+        } else {
+          next_state = SOFTMAX_NORM;
+        }
+        break;
+      }
       case SOFTMAX_NORM: next_state = WRITE; break;
+      case SOFTMAX_ACC: next_state = ROW_NEXT; break;
+
+      // Row statistics pass, no write back
+      case ROW_NEXT: {
+        bool vec_end = 0;
+        nmp_config.UpdateVectorCounter(vec_end);
+        if (vec_end) {
+          next_state = op_softmax ? SOFTMAX_SUM : RMS_SQRT;
+        } else {
+          next_state = PRE;
+        }
+        break;
+      } // ROW_NEXT
 
       case WRITE: next_state = NEXT; break;
       case NEXT: {
@@ -441,6 +654,9 @@ public:
         nmp_config.UpdateVectorCounter(vec_end);
         if (vec_end) {
           nmp_config.UpdateTimestepCounter(time_end);
+          // Next timestep starts a fresh row
+          is_row_norm = 0;
+          ResetRowStats();
         }
         // Decide next state based on end conditions
         next_state = (vec_end && time_end) ? FIN : PRE;
@@ -15,12 +15,18 @@
  */
 
 // =============================================================================
-// NMP Unit Testbench (AXI + RMSNorm + Softmax)
+// NMP Unit Testbench (AXI + RMSNorm + Softmax + LayerNorm)
 // =============================================================================
 // This testbench validates the NMP module by exercising:
 // - AXI config write/readback for NMP configuration registers.
 // - RMSNorm processing on a randomized input vector.
 // - Softmax processing on a deterministic, numerically stable vector.
+// - Row-wide softmax across two vectors of one timestep.
+// - Row-wide softmax across eight vectors whose running max jumps late in
+//   the row, so the running sum has to be rescaled by exp(prev_max - max).
+// - Row-wide LayerNorm and RMSNorm, per-vector affine LayerNorm, and the
+//   gamma/beta read requests to memory_index_2.
+// - Rejection of the unused modes 3-7.
 // =============================================================================
 
 #include <ac_math.h>
@@ -127,15 +133,112 @@ bool vectors_match_with_tolerance(
   }
 }
 
+  // Softmax over the concatenation of num_vectors vectors (one timestep row)
+  static const int kRowVectors = 2;
+  static const int kLongRowVectors = 8;
+  void compute_row_softmax_expected(const spec::VectorType in[], spec::VectorType out[],
+      const int num_vectors = kRowVectors) {
+  const int n = num_vectors * spec::kVectorSize;
+  std::vector<double> vals_full(n, 0.0);
+  for (int v = 0; v < num_vectors; v++) {
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      vals_full[v * spec::kVectorSize + i] = fixed2float<spec::kIntWordWidth, spec::kIntWordWidth - spec::NMP::kNmpInputNumFrac>(in[v][i]);
+    }
+  }
+
+  double max_val = vals_full[0];
+  for (int i = 1; i < n; i++) {
+    if (vals_full[i] > max_val) {
+      max_val = vals_full[i];
+    }
+  }
+
+  double sum_exp = 0.0;
+  for (int i = 0; i < n; i++) {
+    sum_exp += std::exp(vals_full[i] - max_val);
+  }
+
+  for (int v = 0; v < num_vectors; v++) {
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      const double out_val = std::exp(vals_full[v * spec::kVectorSize + i] - max_val) / sum_exp;
+      out[v][i] = float2fixed(out_val, spec::NMP::kNmpInputNumFrac);
+    }
+  }
+}
+
+  // RMSNorm over the concatenation of num_vectors vectors
+  void compute_row_rms_expected(const spec::VectorType in[], spec::VectorType out[],
+      const int num_vectors = kRowVectors) {
+  const int n = num_vectors * spec::kVectorSize;
+  std::vector<double> vals_full(n, 0.0);
+  double sum_sq = 0.0;
+  for (int v = 0; v < num_vectors; v++) {
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      const double x = fixed2float<spec::kIntWordWidth, spec::kIntWordWidth - spec::NMP::kNmpInputNumFrac>(in[v][i]);
+      vals_full[v * spec::kVectorSize + i] = x;
+      sum_sq += x * x;
+    }
+  }
+  const double epsilon        = 1e-4;
+  const double rms_reciprocal = 1.0 / std::sqrt(sum_sq / n + epsilon);
+
+  for (int v = 0; v < num_vectors; v++) {
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      out[v][i] = float2fixed(vals_full[v * spec::kVectorSize + i] * rms_reciprocal, spec::NMP::kNmpInputNumFrac);
+    }
+  }
+}
+
+  // LayerNorm over num_vectors vectors followed by per-channel gamma/beta (Q2.6)
+  void compute_row_layernorm_expected(const spec::VectorType in[],
+      const spec::VectorType gamma[], const spec::VectorType beta[],
+      spec::VectorType out[], const int num_vectors = kRowVectors) {
+  const int n = num_vectors * spec::kVectorSize;
+  std::vector<double> vals_full(n, 0.0);
+  for (int v = 0; v < num_vectors; v++) {
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      vals_full[v * spec::kVectorSize + i] = fixed2float<spec::kIntWordWidth, spec::kIntWordWidth - spec::NMP::kNmpInputNumFrac>(in[v][i]);
+    }
+  }
+
+  double mean = 0.0;
+  for (int i = 0; i < n; i++) {
+    mean += vals_full[i];
+  }
+  mean /= n;
+  double var = 0.0;
+  for (int i = 0; i < n; i++) {
+    var += (vals_full[i] - mean) * (vals_full[i] - mean);
+  }
+  var /= n;
+  const double epsilon = 1e-4;
+  const double inv_std = 1.0 / std::sqrt(var + epsilon);
+
+  for (int v = 0; v < num_vectors; v++) {
+    for (int i = 0; i < spec::kVectorSize; i++) {
+      const double g = fixed2float<spec::kIntWordWidth, spec::kIntWordWidth - spec::NMP::kNmpParamNumFrac>(gamma[v][i]);
+      const double b = fixed2float<spec::kIntWordWidth, spec::kIntWordWidth - spec::NMP::kNmpParamNumFrac>(beta[v][i]);
+      const double out_val = (vals_full[v * spec::kVectorSize + i] - mean) * inv_std * g + b;
+      out[v][i] = float2fixed(out_val, spec::NMP::kNmpInputNumFrac);
+    }
+  }
+}
+
   NVUINTW(128) make_nmp_cfg_data(
     uint8_t mode,
     uint8_t mem,
     uint8_t nvec,
-    uint16_t ntimesteps) {
+    uint16_t ntimesteps,
+    bool is_row = false,
+    bool is_affine = false,
+    uint8_t mem2 = 0) {
   NVUINTW(128) data = 0;
   data.set_slc<1>(0, NVUINT1(1));
   data.set_slc<3>(8, NVUINT3(mode));
+  data.set_slc<1>(16, NVUINT1(is_row));
+  data.set_slc<1>(24, NVUINT1(is_affine));
   data.set_slc<3>(32, NVUINT3(mem));
+  data.set_slc<3>(40, NVUINT3(mem2));
   data.set_slc<8>(48, NVUINT8(nvec));
   data.set_slc<16>(64, NVUINT16(ntimesteps));
   return data;
@@ -148,10 +251,13 @@ spec::Axi::SubordinateToRVA::Write make_cfg(
     uint8_t mode,
     uint8_t mem,
     uint8_t nvec,
-    uint16_t ntimestep) {
+    uint16_t ntimestep,
+    bool is_row = false,
+    bool is_affine = false,
+    uint8_t mem2 = 0) {
   spec::Axi::SubordinateToRVA::Write w;
   w.rw   = 1;
-  w.data = make_nmp_cfg_data(mode, mem, nvec, ntimestep);
+  w.data = make_nmp_cfg_data(mode, mem, nvec, ntimestep, is_row, is_affine, mem2);
   w.addr = set_bytes<3>("C0_00_10");
   return w;
 }
@@ -176,20 +282,47 @@ spec::Axi::SubordinateToRVA::Write make_cfg_read() {
 // Global State Variables
 // =============================================================================
 
-// Expected AXI config data for readback verification
-NVUINTW(128) expected_cfg_data;
-// Flag indicating config data has been written
-bool expected_cfg_valid = false;
+// Expected AXI config readbacks, in request order
+std::deque<NVUINTW(128)> expected_cfg_reads;
 // Expected RMSNorm output (golden reference)
 spec::VectorType expected_rms_data;
 // Expected Softmax output (golden reference)
 spec::VectorType expected_softmax_data;
+// Expected row-wide Softmax output, one vector per row position
+spec::VectorType expected_row_softmax_data[kRowVectors];
+// Expected row-wide Softmax output of the long row with a late max jump
+spec::VectorType expected_long_row_softmax_data[kLongRowVectors];
+// Expected row-wide RMSNorm output
+spec::VectorType expected_row_rms_data[kRowVectors];
+// Expected per-vector LayerNorm output with gamma/beta applied
+spec::VectorType expected_affine_layernorm_data[kRowVectors];
+// Expected row-wide LayerNorm output with gamma/beta applied
+spec::VectorType expected_row_layernorm_data[kRowVectors];
 // Flags for tracking test progress
-bool expected_rms_valid     = false;
-bool expected_softmax_valid = false;
-bool seen_cfg_read          = false;
-bool seen_rms_write         = false;
-bool seen_softmax_write     = false;
+bool expected_rms_valid         = false;
+bool expected_softmax_valid     = false;
+bool expected_row_softmax_valid = false;
+bool expected_row_layernorm_valid = false;
+bool expected_long_row_softmax_valid = false;
+bool expected_row_rms_valid     = false;
+bool expected_affine_layernorm_valid = false;
+// No large-buffer request may follow a rejected start
+bool expected_nmp_idle          = false;
+bool seen_rms_write             = false;
+bool seen_softmax_write         = false;
+int  seen_row_softmax_writes    = 0;
+int  seen_row_layernorm_writes  = 0;
+int  seen_long_row_softmax_writes = 0;
+int  seen_row_rms_writes        = 0;
+int  seen_affine_layernorm_writes = 0;
+
+// gamma/beta read requests of the running affine test: memory_index_2,
+// timestep 0 (gamma) then 1 (beta) for each vector in turn
+int param_mem_index      = -1;
+int param_num_vectors    = 1;
+int seen_param_reads     = 0;
+int total_param_reads    = 0;
+int expected_param_reads = 0;
 
 // =============================================================================
 // Source Module
@@ -228,8 +361,7 @@ SC_MODULE(Source) {
     // Test 1: AXI RW test - write config
     spec::Axi::SubordinateToRVA::Write rva_in_src;
     rva_in_src         = make_cfg(0, 3, 2, 4);
-    expected_cfg_data  = make_nmp_cfg_data(0, 3, 2, 4);
-    expected_cfg_valid = true;
+    expected_cfg_reads.push_back(make_nmp_cfg_data(0, 3, 2, 4));
     rva_in.Push(rva_in_src);
     wait(2);
 
@@ -267,6 +399,171 @@ SC_MODULE(Source) {
 
     large_rsp_src.read_vector[0] = softmax_vals;
     large_rsp.Push(large_rsp_src);
+    wait(50);
+
+    // Test 4: Row-wide Softmax test, the row is read once for statistics
+    // and once more to normalize
+    spec::VectorType row_vals[kRowVectors];
+    for (int v = 0; v < kRowVectors; v++) {
+      row_vals[v] = nvhls::get_rand<spec::VectorType::width>();
+    }
+    compute_row_softmax_expected(row_vals, expected_row_softmax_data);
+    expected_row_softmax_valid = true;
+    rva_in_src                 = make_cfg(1, 2, kRowVectors, 1, true);
+    rva_in.Push(rva_in_src);
+    wait();
+
+    start_src = 1;
+    start.Push(start_src);
+    wait(4);
+
+    for (int pass = 0; pass < 2; pass++) {
+      for (int v = 0; v < kRowVectors; v++) {
+        large_rsp_src.read_vector[0] = row_vals[v];
+        large_rsp.Push(large_rsp_src);
+      }
+    }
+    wait(50);
+
+    // Test 5: Row-wide LayerNorm with gamma/beta, the normalize pass reads
+    // gamma then beta after each vector
+    spec::VectorType ln_vals[kRowVectors], ln_gamma[kRowVectors], ln_beta[kRowVectors];
+    for (int v = 0; v < kRowVectors; v++) {
+      ln_vals[v] = nvhls::get_rand<spec::VectorType::width>();
+      for (int i = 0; i < spec::kVectorSize; i++) {
+        // gamma in [0.5, 1.5), beta in [-0.5, 0.5) keep outputs in range
+        ln_gamma[v][i] = 32 + (rand() % 64);
+        ln_beta[v][i]  = (spec::ScalarType)(rand() % 64 - 32);
+      }
+    }
+    compute_row_layernorm_expected(ln_vals, ln_gamma, ln_beta, expected_row_layernorm_data);
+    expected_row_layernorm_valid = true;
+    param_mem_index              = 3;
+    param_num_vectors            = kRowVectors;
+    seen_param_reads             = 0;
+    expected_param_reads        += 2 * kRowVectors;
+    rva_in_src                   = make_cfg(2, 2, kRowVectors, 1, true, true, 3);
+    rva_in.Push(rva_in_src);
+    wait();
+
+    start_src = 1;
+    start.Push(start_src);
+    wait(4);
+
+    for (int v = 0; v < kRowVectors; v++) {
+      large_rsp_src.read_vector[0] = ln_vals[v];
+      large_rsp.Push(large_rsp_src);
+    }
+    for (int v = 0; v < kRowVectors; v++) {
+      large_rsp_src.read_vector[0] = ln_vals[v];
+      large_rsp.Push(large_rsp_src);
+      large_rsp_src.read_vector[0] = ln_gamma[v];
+      large_rsp.Push(large_rsp_src);
+      large_rsp_src.read_vector[0] = ln_beta[v];
+      large_rsp.Push(large_rsp_src);
+    }
+    wait(50);
+
+    // Test 6: Row-wide Softmax over kLongRowVectors vectors in [-1, 0] with a
+    // single 7.9375 lane in the middle of the row: the running sum gathered
+    // before the jump must be rescaled by about exp(-8), otherwise the large
+    // lane no longer dominates the normalized row
+    spec::VectorType long_row_vals[kLongRowVectors];
+    for (int v = 0; v < kLongRowVectors; v++) {
+      for (int i = 0; i < spec::kVectorSize; i++) {
+        long_row_vals[v][i] = (spec::ScalarType)(-(rand() % 17));
+      }
+    }
+    long_row_vals[kLongRowVectors / 2][5] = 127;
+    compute_row_softmax_expected(long_row_vals, expected_long_row_softmax_data, kLongRowVectors);
+    expected_long_row_softmax_valid = true;
+    rva_in_src                      = make_cfg(1, 2, kLongRowVectors, 1, true);
+    rva_in.Push(rva_in_src);
+    wait();
+
+    start_src = 1;
+    start.Push(start_src);
+    wait(4);
+
+    for (int pass = 0; pass < 2; pass++) {
+      for (int v = 0; v < kLongRowVectors; v++) {
+        large_rsp_src.read_vector[0] = long_row_vals[v];
+        large_rsp.Push(large_rsp_src);
+      }
+    }
+    wait(50);
+
+    // Test 7: Row-wide RMSNorm (mode 0 with is_row), no gamma/beta
+    spec::VectorType rms_row_vals[kRowVectors];
+    for (int v = 0; v < kRowVectors; v++) {
+      rms_row_vals[v] = nvhls::get_rand<spec::VectorType::width>();
+    }
+    compute_row_rms_expected(rms_row_vals, expected_row_rms_data);
+    expected_row_rms_valid = true;
+    rva_in_src             = make_cfg(0, 2, kRowVectors, 1, true);
+    rva_in.Push(rva_in_src);
+    wait();
+
+    start_src = 1;
+    start.Push(start_src);
+    wait(4);
+
+    for (int pass = 0; pass < 2; pass++) {
+      for (int v = 0; v < kRowVectors; v++) {
+        large_rsp_src.read_vector[0] = rms_row_vals[v];
+        large_rsp.Push(large_rsp_src);
+      }
+    }
+    wait(50);
+
+    // Test 8: Affine LayerNorm without is_row, each vector is normalized on
+    // its own and reads gamma then beta of its vector index
+    spec::VectorType aff_vals[kRowVectors], aff_gamma[kRowVectors], aff_beta[kRowVectors];
+    for (int v = 0; v < kRowVectors; v++) {
+      aff_vals[v] = nvhls::get_rand<spec::VectorType::width>();
+      for (int i = 0; i < spec::kVectorSize; i++) {
+        aff_gamma[v][i] = 32 + (rand() % 64);
+        aff_beta[v][i]  = (spec::ScalarType)(rand() % 64 - 32);
+      }
+      compute_row_layernorm_expected(&aff_vals[v], &aff_gamma[v], &aff_beta[v],
+                                     &expected_affine_layernorm_data[v], 1);
+    }
+    expected_affine_layernorm_valid = true;
+    param_mem_index                 = 4;
+    param_num_vectors               = kRowVectors;
+    seen_param_reads                = 0;
+    expected_param_reads           += 2 * kRowVectors;
+    rva_in_src                      = make_cfg(2, 2, kRowVectors, 1, false, true, 4);
+    rva_in.Push(rva_in_src);
+    wait();
+
+    start_src = 1;
+    start.Push(start_src);
+    wait(4);
+
+    for (int v = 0; v < kRowVectors; v++) {
+      large_rsp_src.read_vector[0] = aff_vals[v];
+      large_rsp.Push(large_rsp_src);
+      large_rsp_src.read_vector[0] = aff_gamma[v];
+      large_rsp.Push(large_rsp_src);
+      large_rsp_src.read_vector[0] = aff_beta[v];
+      large_rsp.Push(large_rsp_src);
+    }
+    wait(50);
+
+    // Test 9: Unused mode 5 reads back with is_valid cleared and its start
+    // is dropped without touching the large buffer
+    NVUINTW(128) rejected_cfg = make_nmp_cfg_data(5, 2, 1, 1);
+    rejected_cfg.set_slc<1>(0, NVUINT1(0));
+    expected_cfg_reads.push_back(rejected_cfg);
+    rva_in.Push(make_cfg(5, 2, 1, 1));
+    wait(2);
+    rva_in.Push(make_cfg_read());
+    wait(20);
+
+    expected_nmp_idle = true;
+    start_src = 1;
+    start.Push(start_src);
     wait();
   }
 };
@@ -310,6 +607,21 @@ SC_MODULE(Dest) {
              << " memory_index: " << large_req_dest.memory_index
              << " vector_index: " << large_req_dest.vector_index
              << " timestep_index: " << large_req_dest.timestep_index << endl;
+        if (expected_nmp_idle) {
+          SC_REPORT_ERROR("NMP", "Large buffer request after a rejected start");
+        }
+        if (!large_req_dest.is_write && large_req_dest.memory_index == param_mem_index) {
+          const int expected_timestep = seen_param_reads % 2;
+          const int expected_vector   = (seen_param_reads / 2) % param_num_vectors;
+          if (large_req_dest.timestep_index != expected_timestep ||
+              large_req_dest.vector_index != expected_vector) {
+            SC_REPORT_ERROR("NMP", "Param read request mismatch");
+          } else {
+            cout << sc_time_stamp() << " Param read request matched" << endl;
+          }
+          seen_param_reads++;
+          total_param_reads++;
+        }
         if (large_req_dest.is_write) {
           if (expected_rms_valid && !seen_rms_write) {
             if (!vectors_match_with_tolerance(
@@ -327,19 +639,66 @@ SC_MODULE(Dest) {
               cout << sc_time_stamp() << " Softmax write data matched" << endl;
             }
             seen_softmax_write = true;
+          } else if (expected_row_softmax_valid && seen_row_softmax_writes < kRowVectors) {
+            const int v = large_req_dest.vector_index;
+            if (!vectors_match_with_tolerance(
+                    large_req_dest.write_data, expected_row_softmax_data[v])) {
+              SC_REPORT_ERROR("NMP", "Row softmax write data mismatch");
+            } else {
+              cout << sc_time_stamp() << " Row softmax write data matched" << endl;
+            }
+            seen_row_softmax_writes++;
+          } else if (expected_row_layernorm_valid && seen_row_layernorm_writes < kRowVectors) {
+            const int v = large_req_dest.vector_index;
+            if (!vectors_match_with_tolerance(
+                    large_req_dest.write_data, expected_row_layernorm_data[v])) {
+              SC_REPORT_ERROR("NMP", "Row LayerNorm write data mismatch");
+            } else {
+              cout << sc_time_stamp() << " Row LayerNorm write data matched" << endl;
+            }
+            seen_row_layernorm_writes++;
+          } else if (expected_long_row_softmax_valid && seen_long_row_softmax_writes < kLongRowVectors) {
+            const int v = large_req_dest.vector_index;
+            if (!vectors_match_with_tolerance(
+                    large_req_dest.write_data, expected_long_row_softmax_data[v])) {
+              SC_REPORT_ERROR("NMP", "Long row softmax write data mismatch");
+            } else {
+              cout << sc_time_stamp() << " Long row softmax write data matched" << endl;
+            }
+            seen_long_row_softmax_writes++;
+          } else if (expected_row_rms_valid && seen_row_rms_writes < kRowVectors) {
+            const int v = large_req_dest.vector_index;
+            if (!vectors_match_with_tolerance(
+                    large_req_dest.write_data, expected_row_rms_data[v])) {
+              SC_REPORT_ERROR("NMP", "Row RMSNorm write data mismatch");
+            } else {
+              cout << sc_time_stamp() << " Row RMSNorm write data matched" << endl;
+            }
+            seen_row_rms_writes++;
+          } else if (expected_affine_layernorm_valid && seen_affine_layernorm_writes < kRowVectors) {
+            const int v = large_req_dest.vector_index;
+            if (!vectors_match_with_tolerance(
+                    large_req_dest.write_data, expected_affine_layernorm_data[v])) {
+              SC_REPORT_ERROR("NMP", "Affine LayerNorm write data mismatch");
+            } else {
+              cout << sc_time_stamp() << " Affine LayerNorm write data matched" << endl;
+            }
+            seen_affine_layernorm_writes++;
           }
         }
       }
       if (rva_out.PopNB(rva_out_dest)) {
         cout << hex << sc_time_stamp()
              << " Dest rva data = " << rva_out_dest.data << endl;
-        if (expected_cfg_valid && !seen_cfg_read) {
-          if (rva_out_dest.data != expected_cfg_data) {
+        if (expected_cfg_reads.empty()) {
+          SC_REPORT_ERROR("NMP", "Unexpected RVA read response");
+        } else {
+          if (rva_out_dest.data != expected_cfg_reads.front()) {
             SC_REPORT_ERROR("NMP", "RVA config readback mismatch");
           } else {
             cout << sc_time_stamp() << " RVA config matched" << endl;
           }
-          seen_cfg_read = true;
+          expected_cfg_reads.pop_front();
         }
       }
 
@@ -436,6 +795,29 @@ int sc_main(int argc, char* argv[]) {
   sc_report_handler::set_actions(SC_ERROR, SC_DISPLAY);
   sc_start();
 
+  // Every row position must have been written back
+  if (seen_row_softmax_writes != kRowVectors) {
+    SC_REPORT_ERROR("NMP", "Row softmax write count mismatch");
+  }
+  if (seen_long_row_softmax_writes != kLongRowVectors) {
+    SC_REPORT_ERROR("NMP", "Long row softmax write count mismatch");
+  }
+  if (seen_row_layernorm_writes != kRowVectors) {
+    SC_REPORT_ERROR("NMP", "Row LayerNorm write count mismatch");
+  }
+  if (seen_row_rms_writes != kRowVectors) {
+    SC_REPORT_ERROR("NMP", "Row RMSNorm write count mismatch");
+  }
+  if (seen_affine_layernorm_writes != kRowVectors) {
+    SC_REPORT_ERROR("NMP", "Affine LayerNorm write count mismatch");
+  }
+  if (total_param_reads != expected_param_reads) {
+    SC_REPORT_ERROR("NMP", "Param read request count mismatch");
+  }
+  if (!expected_cfg_reads.empty()) {
+    SC_REPORT_ERROR("NMP", "Missing RVA config readback");
+  }
+
   // Return pass/fail based on error count
   bool rc = (sc_report_handler::get_count(SC_ERROR) > 0);
   if (rc)
@@ -40,7 +40,7 @@
 
 #include "PPU.h"
 
-// Use terminology OP A2 A1
+// Use terminology OP DST SRC1 SRC2 (see ActConfig::InstDecode)
 class ActUnit : public match::Module {
   static const int kDebugLevel = 4;
   SC_HAS_PROCESS(ActUnit);
@@ -58,6 +58,8 @@ class ActUnit : public match::Module {
  protected:
   // Internal states
   spec::ActVectorType act_regs[spec::kNumActEntries];       //  XXX: cannot be configured anymore
+  spec::Act::ReduceType red_regs[spec::Act::kNumReduceEntries];
+  bool red_valid[spec::Act::kNumReduceEntries];             // cleared on start
   
   ArbitratedScratchpadDP<spec::Act::kNumBanks,      // 1
                          spec::Act::kNumReadPorts,  // 1
@@ -65,8 +67,18 @@ class ActUnit : public match::Module {
                          spec::Act::kEntriesPerBank, 
                          spec::Act::WordType, 
                          false, true> act_mem;
+  ArbitratedScratchpadDP<spec::Act::Param::kNumBanks,      // 2 (lane halves)
+                         spec::Act::Param::kNumReadPorts,  // 2
+                         spec::Act::Param::kNumWritePorts, // 1
+                         spec::Act::Param::kEntriesPerBank, 
+                         spec::Act::Param::WordType, 
+                         false, true> param_mem;
   ActConfig act_config;
+  ActLut act_lut;
   bool is_start;
+  // next act_port vector, popped ahead of the INPE that consumes it
+  spec::ActVectorType act_port_prefetch;
+  bool is_prefetch_valid;
   
   
   
@@ -97,10 +109,22 @@ class ActUnit : public match::Module {
   bool                act_read_ready          [spec::Act::kNumReadPorts];
   spec::Act::WordType act_port_read_out       [spec::Act::kNumReadPorts];
   bool                act_port_read_out_valid [spec::Act::kNumReadPorts];       
+
+  spec::Act::Param::Address  param_read_addrs          [spec::Act::Param::kNumReadPorts]; 
+  bool                       param_read_req_valid      [spec::Act::Param::kNumReadPorts];     
+  spec::Act::Param::Address  param_write_addrs         [spec::Act::Param::kNumWritePorts];
+  bool                       param_write_req_valid     [spec::Act::Param::kNumWritePorts];
+  spec::Act::Param::WordType param_write_data          [spec::Act::Param::kNumWritePorts];
+  bool                       param_read_ack            [spec::Act::Param::kNumReadPorts]; 
+  bool                       param_write_ack           [spec::Act::Param::kNumWritePorts];
+  bool                       param_read_ready          [spec::Act::Param::kNumReadPorts];
+  spec::Act::Param::WordType param_port_read_out       [spec::Act::Param::kNumReadPorts];
+  bool                       param_port_read_out_valid [spec::Act::Param::kNumReadPorts];       
   
   // while loop internal states
 //  bool w_axi_req, w_axi_rsp, w_out, w_load, w_done;
-  bool w_axi_rsp, w_out, w_load, w_done;      
+  bool w_axi_rsp, w_out, w_load, w_param, w_done;      
+  bool w_loop, w_jump;
   bool is_incr;
   spec::Axi::SubordinateToRVA::Read rva_out_reg;  
   //NVUINT8 curr_inst;
@@ -108,9 +132,12 @@ class ActUnit : public match::Module {
   //******* Reset Families
   void Reset() {
     act_config.Reset();
+    act_lut.Reset();
     ResetPorts();
     ResetActRegs();
     is_start = 0;
+    act_port_prefetch = 0;
+    is_prefetch_valid = 0;
   }
  
   void ResetPorts() {
@@ -127,6 +154,15 @@ class ActUnit : public match::Module {
     for (int i = 0; i < spec::kNumActEntries; i++) {
       act_regs[i] = 0;
     }
+    ResetRedRegs();
+  }
+
+  void ResetRedRegs(){
+    #pragma hls_unroll yes 
+    for (int i = 0; i < spec::Act::kNumReduceEntries; i++) {
+      red_regs[i] = 0;
+      red_valid[i] = 0;
+    }
   }
 
   //****** End Reset Families 
@@ -144,6 +180,16 @@ class ActUnit : public match::Module {
       act_read_addrs[0] = local_index;
       act_read_req_valid[0] = 1;
     }
+    else if (tmp == 0xD) {    // Activation LUT
+      NVUINT4 local_index = nvhls::get_slc<4>(rva_in_reg.addr, 4);
+      rva_out_reg.data = act_lut.LutRead(local_index);
+    }
+    else if (tmp == 0xC) {    // Param bank, one 8-lane half per local_index
+      NVUINT16 local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
+      param_read_ready[0] = 1; 
+      param_read_addrs[0] = local_index;
+      param_read_req_valid[0] = 1;
+    }
   }
   
   void DecodeAxiWrite(const spec::Axi::SubordinateToRVA::Write& rva_in_reg){
@@ -160,6 +206,16 @@ class ActUnit : public match::Module {
       act_write_req_valid[0] = 1;
       act_write_data[0] = rva_in_reg.data;
     }
+    else if (tmp == 0xD) {    // Activation LUT
+      NVUINT4 local_index = nvhls::get_slc<4>(rva_in_reg.addr, 4);
+      act_lut.LutWrite(local_index, rva_in_reg.data);
+    }
+    else if (tmp == 0xC) {    // Param bank, one 8-lane half per local_index
+      NVUINT16 local_index = nvhls::get_slc<16>(rva_in_reg.addr, 4);
+      param_write_addrs[0] = local_index;
+      param_write_req_valid[0] = 1;
+      param_write_data[0] = rva_in_reg.data;
+    }
     //else if (tmp == 0xF) {
     //  if (local_index == 0xFFFF) {
     //    Reset();
@@ -175,6 +231,16 @@ class ActUnit : public match::Module {
     act_write_req_valid     [0] = 0;
     act_write_data          [0] = 0;
     act_read_ready          [0] = 0;
+
+    #pragma hls_unroll yes
+    for (int i = 0; i < spec::Act::Param::kNumReadPorts; i++) {
+      param_read_addrs      [i] = 0; 
+      param_read_req_valid  [i] = 0;     
+      param_read_ready      [i] = 0;
+    }
+    param_write_addrs       [0] = 0;
+    param_write_req_valid   [0] = 0;
+    param_write_data        [0] = 0;
   }
   
   void Initialize() {
@@ -182,15 +248,27 @@ class ActUnit : public match::Module {
     w_axi_rsp = 0;
     w_out = 0;
     w_load = 0;
+    w_param = 0;
     w_done = 0;
+    w_loop = 0;
+    w_jump = 0;
     is_incr = 1;
   }  
   
+  // Refill after RunInst so back-to-back INPEs each take one cycle,
+  // also runs while idle so the next run's first vector is ready at start
+  void PrefetchInput() {
+    if (!is_prefetch_valid) {
+      is_prefetch_valid = act_port.PopNB(act_port_prefetch);
+    }
+  }
+
   void CheckStart() {
     bool start_reg;
     if (start.PopNB(start_reg)) {
       //CDCOUT(sc_time_stamp()  << " ActUnit: " << name() << " Start" << endl, kDebugLevel);
       is_start = act_config.is_valid && start_reg;
+      ResetRedRegs();
     }
   }
   
@@ -214,69 +292,131 @@ class ActUnit : public match::Module {
   
   void RunInst(ActConfig act_config_in) {
     // lock if recieve AXI request or the ActUnit is not started 
-    NVUINT8 curr_inst = act_config_in.InstFetch();
-    NVUINT4 op = nvhls::get_slc<4>(curr_inst, 4);
-    NVUINT2 a2 = nvhls::get_slc<2>(curr_inst, 2);
-    NVUINT2 a1 = nvhls::get_slc<2>(curr_inst, 0);
+    ActInst inst = act_config_in.InstDecode();
+    bool is_sat = act_config_in.is_saturate == 1 || inst.flags[0] == 1;
       
-    switch (op) {
-      case 0x1: { // LOAD SRAM -> A2 FIXME: load address is determined by the output_counter + buffer_addr_base
+    switch (inst.op) {
+      case 0x1: { // LOAD SRAM -> DST FIXME: load address is determined by the output_counter + buffer_addr_base
         w_load = 1;
         if (act_config_in.is_zero_first == 0) {
           act_read_ready[0] = 1;
-          act_read_addrs[0] = act_config_in.output_counter + act_config_in.buffer_addr_base;
+          act_read_addrs[0] = act_config_in.GetIterIndex() + act_config_in.buffer_addr_base;
           act_read_req_valid[0] = 1;
         }
         break;
       }
-      case 0x2: { // STORE SRAM <- A2 FIXME: Store address is determined by the output_counter + buffer_addr_base
-        act_write_addrs[0] = act_config_in.output_counter + act_config_in.buffer_addr_base;
+      case 0x2: { // STORE SRAM <- SRC1 FIXME: Store address is determined by the output_counter + buffer_addr_base
+        act_write_addrs[0] = act_config_in.GetIterIndex() + act_config_in.buffer_addr_base;
         act_write_req_valid[0] = 1;
         for (int i = 0; i < spec::kNumVectorLanes; i++) {
-          act_write_data[0][i] = act_regs[a2][i];
+          act_write_data[0][i] = act_regs[inst.src1][i];
         }
         break;
       }
-      case 0x3: { // INPE act_port -> A2 FIXME: Do not increment instruction if nothing recieved 
-        spec::ActVectorType act_port_reg;
-        if (act_port.PopNB(act_port_reg)) {   
-          act_regs[a2] = act_port_reg;
+      case 0x3: { // INPE act_port -> DST, served from the prefetch register
+        if (is_prefetch_valid) {   
+          act_regs[inst.dst] = act_port_prefetch;
+          is_prefetch_valid = 0;
         }
         else {
           is_incr = 0; // Stall instruction if not recieve act data
         }
         break;
       }
-      case 0x4: { // OUTGB A2 -> Output
+      case 0x4: { // OUTGB SRC1 -> Output
         w_out = 1;
         break;
       }
-      case 0x7: { // COPY A1 -> A2
-        act_regs[a2] = act_regs[a1];
+      case 0x5: { // EFMA SRC1*SRC2 + SRC3 -> DST
+        EFma(act_regs[inst.src1], act_regs[inst.src2], act_regs[inst.src3], is_sat, act_regs[inst.dst]);
+        break;
+      }
+      case 0x6: { // LDPM Param bank -> DST, both lane halves of one parameter vector
+        w_param = 1;
+        spec::Act::Param::VectorIndex param_index = act_config_in.GetParamIndex();
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::Act::Param::kNumReadPorts; i++) {
+          param_read_ready[i] = 1;
+          param_read_addrs[i] = param_index * spec::Act::Param::kNumBanks + i;
+          param_read_req_valid[i] = 1;
+        }
+        break;
+      }
+      case 0x7: { // COPY SRC1 -> DST
+        act_regs[inst.dst] = act_regs[inst.src1];
         break;      
       } 
       case 0x8: { // EADD
-        EAdd(act_regs[a1], act_regs[a2], act_regs[a2]); 
+        EAdd(act_regs[inst.src1], act_regs[inst.src2], is_sat, act_regs[inst.dst]); 
         break;
       }
       case 0x9: { // EMUL
-        EMul(act_regs[a1], act_regs[a2], act_regs[a2]); 
+        EMul(act_regs[inst.src1], act_regs[inst.src2], is_sat, act_regs[inst.dst]); 
+        break;
+      }
+      case 0xA: { // SIGM
+        Sigmoid(act_regs[inst.src1], act_regs[inst.dst]);
         break;
       }
       case 0xB: { // TANH
-        Tanh(act_regs[a2], act_regs[a2]);
+        Tanh(act_regs[inst.src1], act_regs[inst.dst]);
         break;
       }
       case 0xC: { // RELU
-        Relu(act_regs[a2], act_regs[a2]);
+        Relu(act_regs[inst.src1], act_regs[inst.dst]);
+        break;
+      }
+      case 0xD: { // ONEX
+        OneMinus(act_regs[inst.src1], act_regs[inst.dst]);
         break;
       }
       case 0xE: { // SILU
-        Silu(act_regs[a2], act_regs[a2]);
+        Silu(act_regs[inst.src1], act_regs[inst.dst]);
         break;
       }
       case 0xF: { // GELU
-        Gelu(act_regs[a2], act_regs[a2]);
+        Gelu(act_regs[inst.src1], act_regs[inst.dst]);
+        break;
+      }
+      case 0x10: { // LOOP, set up by the sequencer in ActUnitRun
+        w_loop = 1;
+        break;
+      }
+      case 0x11: { // JMP
+        w_jump = act_config_in.IsJumpTaken(inst.dst);
+        break;
+      }
+      case 0x12:   // HSUM
+      case 0x13: { // HSSQ
+        NVUINT2 r = nvhls::get_slc<2>(inst.dst, 0);
+        spec::Act::ReduceType red_tmp;
+        HSum(act_regs[inst.src1], inst.op == 0x13, red_tmp);
+        if (red_valid[r] && inst.flags[1] == 0) {
+          red_regs[r] += red_tmp;
+        }
+        else {
+          red_regs[r] = red_tmp;
+        }
+        red_valid[r] = 1;
+        break;
+      }
+      case 0x14: { // HMAX
+        NVUINT2 r = nvhls::get_slc<2>(inst.dst, 0);
+        spec::Act::ReduceType red_tmp;
+        HMax(act_regs[inst.src1], red_tmp);
+        if (!red_valid[r] || inst.flags[1] == 1 || red_tmp > red_regs[r]) {
+          red_regs[r] = red_tmp;
+        }
+        red_valid[r] = 1;
+        break;
+      }
+      case 0x15: { // HGET
+        NVUINT2 r = nvhls::get_slc<2>(inst.src1, 0);
+        HBroadcast(red_regs[r], act_config_in.reduce_scale, inst.flags[1] == 1, act_regs[inst.dst]);
+        break;
+      }
+      case 0x16: { // ALUT
+        ActLutEval(act_regs[inst.src1], act_lut, is_sat, act_regs[inst.dst]);
         break;
       }
       default: {
@@ -298,21 +438,42 @@ class ActUnit : public match::Module {
       act_port_read_out       ,
       act_port_read_out_valid 
     );    
+    param_mem.run(
+      param_read_addrs          , 
+      param_read_req_valid      ,     
+      param_write_addrs         ,
+      param_write_req_valid     ,
+      param_write_data          ,
+      param_read_ack            ,
+      param_write_ack           ,
+      param_read_ready          ,
+      param_port_read_out       ,
+      param_port_read_out_valid 
+    );    
   }
   
   
   void RunLoad(ActConfig act_config_in) {
     if (w_load) {  // need to move SRAM data to actreg
-      NVUINT8 curr_inst = act_config_in.InstFetch();
       // need write zero function to preform skipping 
-      NVUINT2 a2 = nvhls::get_slc<2>(curr_inst, 2);  
+      spec::Act::RegIndex dst = act_config_in.InstDecode().dst;
       // Write Zero instead if is_zero first is set    
       if (act_config_in.is_zero_first == 1) {
-        act_regs[a2] = 0;
+        act_regs[dst] = 0;
       }
       else {
         for (int i = 0; i < spec::kNumVectorLanes; i++) {
-          act_regs[a2][i] = act_port_read_out[0][i];
+          act_regs[dst][i] = act_port_read_out[0][i];
+        }
+      }
+    }
+    if (w_param) { // parameters are never zero-filled by is_zero_first
+      spec::Act::RegIndex dst = act_config_in.InstDecode().dst;
+      #pragma hls_unroll yes
+      for (int b = 0; b < spec::Act::Param::kNumBanks; b++) {
+        #pragma hls_unroll yes
+        for (int i = 0; i < spec::Act::Param::kNumLanes; i++) {
+          act_regs[dst][b * spec::Act::Param::kNumLanes + i] = param_port_read_out[b][i];
         }
       }
     }
@@ -322,27 +483,20 @@ class ActUnit : public match::Module {
     // output port
     if (w_out) {
       spec::StreamType output_port_reg;
-      NVUINT8 curr_inst = act_config_in.InstFetch();
-      NVUINT2 a2 = nvhls::get_slc<2>(curr_inst, 2);  
+      spec::Act::RegIndex src = act_config_in.InstDecode().src1;
       
-      spec::ActScalarType tmp = 0;
-      spec::Act::kActOutputPortScalar tmp_scalar = 0;
-      spec::Act::kActOutputPortType tmp_output = 0;
+      NVUINT4 out_frac = act_config_in.GetOutFrac();
+      spec::ScalarType out_zero_point = act_config_in.GetOutZeroPoint();
       
       for (int i = 0; i < spec::kNumVectorLanes; i++) {
-        tmp = act_regs[a2][i];
-        tmp_scalar.set_slc(0, tmp);
-        tmp_output = ConvertToActOutput(tmp_scalar);
-        /*cout << "tmp, tmp_ac_fixed, output_port_reg: " << std::hex << tmp << ", " << std::hex <<  tmp_scalar << ", " 
-          << std::hex << tmp_output << endl;*/
-        output_port_reg.data[i] = nvhls::get_slc<spec::kIntWordWidth>(tmp_output, 0);
+        output_port_reg.data[i] = ConvertToActOutput(act_regs[src][i], out_frac, out_zero_point);
       }
       
       // push output 
       // 0322 this follows the format of GB
       // GB does not need index for PE Output
       output_port_reg.index = 0; 
-      output_port_reg.logical_addr = act_config_in.output_counter + act_config_in.output_addr_base;
+      output_port_reg.logical_addr = act_config_in.GetIterIndex() + act_config_in.output_addr_base;
       
       output_port.Push(output_port_reg);
     }
@@ -356,6 +510,9 @@ class ActUnit : public match::Module {
       if (act_port_read_out_valid[0]) {  
         rva_out_reg.data = act_port_read_out[0].to_rawbits();     //  conversion from vector to plain bit seq
       }
+      else if (param_port_read_out_valid[0]) {  
+        rva_out_reg.data = param_port_read_out[0].to_rawbits();
+      }
       rva_out.Push(rva_out_reg);
     }  
   }
@@ -371,6 +528,7 @@ class ActUnit : public match::Module {
       else {
         RunInst(act_config);
       }
+      PrefetchInput();
       
       BufferAccress();
       
@@ -381,17 +539,26 @@ class ActUnit : public match::Module {
       else {
         PushOutput(act_config);      
         RunLoad(act_config);
-        if (is_incr) {
-          bool is_end;
+        if (w_param) {
+          act_config.ParamIncr();
+        }
+        if (w_loop) {
+          ActInst inst = act_config.InstDecode();
+          act_config.LoopSetup(inst.dst, inst.imm);
+        }
+        bool is_end = 0;
+        if (w_jump) {
+          is_end = act_config.InstJump(act_config.InstDecode().imm);
+        }
+        else if (is_incr) {
           is_end = act_config.InstIncr();  
           //CDCOUT(sc_time_stamp()  << " ActUnit: " << name() << " is_end signal: " << is_end << endl, kDebugLevel);
-           
-          // End condition (num_output iterations on instruction is done)
-          if (is_end == 1) {
-            w_done = 1;     // Push done signal
-            done.Push(1);
-            is_start = 0;   // Stop ActUnit in next while iter
-          }
+        }
+        // End condition (num_output iterations on instruction is done)
+        if (is_end == 1) {
+          w_done = 1;     // Push done signal
+          done.Push(1);
+          is_start = 0;   // Stop ActUnit in next while iter
         }
       }
       
@@ -5,6 +5,9 @@
 #include <fstream>
 #include <vector>
 #include <iomanip>
+#include <cmath>
+#include <deque>
+#include <string>
 
 #include "ActUnit.h"
 
@@ -22,6 +25,146 @@ void load_bin(const char* filename, std::vector<T>& buffer, size_t size) {
     file.close();
 }
 
+// Sigmoid gate test input: x_i = (i - 8) * 0.75 in Q4.12, sweeping [-6.0, 5.25]
+inline double gate_input(int i) { return (i - 8) * 0.75; }
+
+// Reference Q4.4 output of the ActUnit (AC_RND, AC_SAT) for a real value
+inline int to_q4_4(double x) {
+    int q = (int)std::floor(x * 16.0 + 0.5);
+    if (q > 127)  q = 127;
+    if (q < -128) q = -128;
+    return q;
+}
+
+// ============================================================
+// Directed wide-instruction programs: Source queues the expected
+// results in program order, Sink pops and checks them
+// ============================================================
+typedef std::vector<int> Lanes;   // 16 lanes, Q4.12 (or int8 for outputs)
+
+enum ActOp { kNop = 0, kLoad, kStore, kInpe, kOutgb, kEfma, kLdpm, kCopy, kEadd, kEmul,
+             kSigm, kTanh, kRelu, kOnex, kSilu, kGelu, kLoop, kJmp, kHsum, kHssq, kHmax,
+             kHget, kAlut };
+
+inline NVUINT16 wide(int op, int dst, int src1 = 0, int src2 = 0, int flags = 0) {
+    return (op << 11) | (dst << 8) | (src1 << 5) | (src2 << 2) | flags;
+}
+
+// LOOP (DST = level, IMM = body length - 1) and JMP (DST = condition, IMM = target)
+inline NVUINT16 wide_imm(int op, int dst, int imm) {
+    return (op << 11) | (dst << 8) | (imm << 3);
+}
+
+// ActConfig register (local index 0x01) and loop counts (0x08)
+struct ActCfg {
+    int is_wide, num_inst, num_output, is_saturate, buffer_addr_base, output_addr_base;
+    int param_addr_base, param_stride, reduce_scale, is_out_format, out_frac, out_zero_point;
+    int loop_count[spec::Act::kNumLoops];
+    ActCfg(int n_inst, int n_out = 1) : is_wide(1), num_inst(n_inst), num_output(n_out), is_saturate(0),
+        buffer_addr_base(0), output_addr_base(0), param_addr_base(0), param_stride(0),
+        reduce_scale(0), is_out_format(0), out_frac(spec::Act::kActOutNumFrac), out_zero_point(0) {
+        for (int l = 0; l < spec::Act::kNumLoops; l++) loop_count[l] = 1;
+    }
+    NVUINTW(128) bits() const {
+        NVUINTW(128) d = 0;
+        d.set_slc(0, (NVUINT1)1);                  d.set_slc(16, (NVUINT1)is_wide);
+        d.set_slc(17, (NVUINT1)is_saturate);       d.set_slc(24, (NVUINT6)num_inst);
+        d.set_slc(32, (NVUINT8)num_output);        d.set_slc(48, (spec::Act::Address)buffer_addr_base);
+        d.set_slc(64, (NVUINT8)output_addr_base);  d.set_slc(80, (spec::Act::Param::VectorIndex)param_addr_base);
+        d.set_slc(88, (NVUINT4)param_stride);      d.set_slc(96, (NVUINT16)reduce_scale);
+        d.set_slc(112, (NVUINT1)is_out_format);    d.set_slc(116, (NVUINT4)out_frac);
+        d.set_slc(120, (NVUINT8)(out_zero_point & 0xFF));
+        return d;
+    }
+};
+
+struct ExpectedOut {
+    std::string name;
+    int addr;
+    Lanes data;   // int8
+};
+
+std::deque<ExpectedOut> expected_outs;
+std::deque<std::pair<std::string, NVUINTW(128)> > expected_reads;
+int  num_directed_programs = 0;
+bool directed_source_done = false;
+
+// Output conversion reference: round(x * 2^out_frac) half up (AC_RND) + zero point, saturated
+inline int ref_out(int q412, int out_frac = spec::Act::kActOutNumFrac, int zero_point = 0) {
+    int q = (int)std::floor(q412 * std::pow(2.0, out_frac - spec::kActNumFrac) + 0.5) + zero_point;
+    if (q > 127)  q = 127;
+    if (q < -128) q = -128;
+    return q;
+}
+
+inline Lanes ref_out(const Lanes& q412, int out_frac = spec::Act::kActOutNumFrac, int zero_point = 0) {
+    Lanes out(q412.size());
+    for (unsigned i = 0; i < q412.size(); i++) out[i] = ref_out(q412[i], out_frac, zero_point);
+    return out;
+}
+
+// Cross-lane reduction reference in Q20.20 units (2^-20): lanes are Q4.12,
+// a square is Q8.24 truncated onto the Q20.20 register
+inline long long ref_hsum(const Lanes& v, bool is_square) {
+    long long sum = 0;
+    for (unsigned i = 0; i < v.size(); i++) {
+        if (is_square) sum += ((long long)v[i] * v[i]) >> 4;
+        else sum += (long long)v[i] << 8;
+    }
+    return sum;
+}
+
+inline long long ref_hmax(const Lanes& v) {
+    int max_val = v[0];
+    for (unsigned i = 1; i < v.size(); i++) max_val = std::max(max_val, v[i]);
+    return (long long)max_val << 8;
+}
+
+// HGET: times reduce_scale (unsigned 0.16, 0 means 1.0) when scaled,
+// truncated and saturated to Q4.12, broadcast to all lanes
+inline Lanes ref_hget(long long red, int reduce_scale, bool is_scale) {
+    long long v;
+    if (is_scale && reduce_scale != 0) v = (red * reduce_scale) >> 24;
+    else v = red >> 8;
+    if (v > spec::kActWordMax) v = spec::kActWordMax;
+    if (v < -(1 << (spec::kActWordWidth - 1))) v = -(1 << (spec::kActWordWidth - 1));
+    return Lanes(spec::kNumVectorLanes, (int)v);
+}
+
+// Two's complement wrap of a Q4.12 result, or clamp when saturating
+inline int ref_q412(long long v, bool is_sat) {
+    const long long kMin = -(1LL << (spec::kActWordWidth - 1)), kMax = spec::kActWordMax;
+    if (is_sat) return (int)std::min(std::max(v, kMin), kMax);
+    return (int)(int16_t)(uint16_t)(v & 0xFFFF);
+}
+
+// ALUT: segment k is the last one with breakpoint[k] <= x (breakpoint[0] is
+// -inf), y = slope[k]*x + offset[k] at Q8.24, truncated to Q4.12
+inline Lanes ref_alut(const Lanes& x, const Lanes& bp, const Lanes& slope, const Lanes& offset, bool is_sat) {
+    Lanes y(x.size());
+    for (unsigned i = 0; i < x.size(); i++) {
+        int seg = 0;
+        for (int k = 1; k < spec::Act::kNumLutSegments; k++) {
+            if (x[i] >= bp[k]) seg = k;
+        }
+        long long y24 = (long long)slope[seg] * x[i] + ((long long)offset[seg] << spec::kActNumFrac);
+        y[i] = ref_q412(y24 >> spec::kActNumFrac, is_sat);
+    }
+    return y;
+}
+
+inline NVUINTW(128) pack_half(const Lanes& v, int half) {
+    NVUINTW(128) d = 0;
+    for (int i = 0; i < 8; i++) d.set_slc(16*i, (NVUINT16)(v[half*8 + i] & 0xFFFF));
+    return d;
+}
+
+inline spec::ActVectorType to_act_vector(const Lanes& v) {
+    spec::ActVectorType out;
+    for (int i = 0; i < spec::kNumVectorLanes; i++) out[i] = v[i];
+    return out;
+}
+
 // ============================================================
 // Source: drives AXI config, start, and act_port into the DUT
 // ============================================================
@@ -48,6 +191,399 @@ SC_MODULE(Source) {
         rva_in.Push(cmd);
     }
 
+    // Any ActUnit region: 0x8 config, 0x9 buffer, 0xC params, 0xD activation LUT
+    void write(int region, int local_index, const NVUINTW(128)& data) {
+        spec::Axi::SubordinateToRVA::Write cmd;
+        cmd.rw = 1;
+        cmd.addr = ((NVUINTW(24))region << 20) | ((NVUINTW(24))local_index << 4);
+        cmd.data = data;
+        rva_in.Push(cmd);
+        wait();
+    }
+
+    // Read back, the response is checked by Sink
+    void read(int region, int local_index, const std::string& name, const NVUINTW(128)& expected) {
+        expected_reads.push_back(std::make_pair(name, expected));
+        spec::Axi::SubordinateToRVA::Write cmd;
+        cmd.rw = 0;
+        cmd.addr = ((NVUINTW(24))region << 20) | ((NVUINTW(24))local_index << 4);
+        cmd.data = 0;
+        rva_in.Push(cmd);
+        wait();
+    }
+
+    // Wide programs go to 0x04-0x07 (8 per word), 8-bit ones to 0x02-0x03 (16 per word)
+    void load_program(const std::vector<NVUINT16>& prog, const ActCfg& cfg) {
+        const unsigned per_word = cfg.is_wide ? 8 : 16;
+        for (unsigned b = 0; b < (prog.size() + per_word - 1) / per_word; b++) {
+            NVUINTW(128) d = 0;
+            for (unsigned i = 0; i < per_word && b*per_word + i < prog.size(); i++) {
+                if (cfg.is_wide) d.set_slc(16*i, prog[b*per_word + i]);
+                else d.set_slc(8*i, (NVUINT8)prog[b*per_word + i]);
+            }
+            write(0x8, (cfg.is_wide ? 0x04 : 0x02) + b, d);
+        }
+        NVUINTW(128) loops = 0;
+        for (int l = 0; l < spec::Act::kNumLoops; l++) loops.set_slc(8*l, (NVUINT8)cfg.loop_count[l]);
+        write(0x8, 0x08, loops);
+        write(0x8, 0x01, cfg.bits());
+    }
+
+    void expect(const std::string& name, int addr, const Lanes& int8_data) {
+        ExpectedOut e = {name, addr, int8_data};
+        expected_outs.push_back(e);
+    }
+
+    void run_program(const std::vector<Lanes>& inputs) {
+        num_directed_programs++;
+        start.Push(true);
+        wait();
+        for (unsigned i = 0; i < inputs.size(); i++) {
+            act_port.Push(to_act_vector(inputs[i]));
+            wait();
+        }
+    }
+
+    // Nested hardware loops with an end of pass JMP. Each output owns
+    // loop_count[0] = 3 consecutive vectors; the outer loop (2 iterations)
+    // doubles the bias each time, and the last instruction jumps back over
+    // the bias prologue on every output but the last.
+    //   0: INPE R2            bias, first output only
+    //   1: LOOP L1, 2..6
+    //   2:   EADD R2 = R2+R2
+    //   3:   LOOP L0, 4..6
+    //   4:     INPE R1
+    //   5:     EADD R4 = R1+R2
+    //   6:     OUTGB R4       address o*3 + i0
+    //   7: JMP not last -> 1
+    void test_loop_jump() {
+        const int N_OUT = 2, L0 = 3, L1 = 2;
+        std::vector<NVUINT16> prog;
+        prog.push_back(wide(kInpe, 2));
+        prog.push_back(wide_imm(kLoop, 1, 4));
+        prog.push_back(wide(kEadd, 2, 2, 2));
+        prog.push_back(wide_imm(kLoop, 0, 2));
+        prog.push_back(wide(kInpe, 1));
+        prog.push_back(wide(kEadd, 4, 1, 2));
+        prog.push_back(wide(kOutgb, 0, 4));
+        prog.push_back(wide_imm(kJmp, 3, 1));
+        ActCfg cfg(prog.size(), N_OUT);
+        cfg.loop_count[0] = L0; cfg.loop_count[1] = L1;
+        load_program(prog, cfg);
+
+        std::vector<Lanes> inputs;
+        Lanes bias(16);
+        for (int j = 0; j < 16; j++) bias[j] = 256 * (j % 4);
+        inputs.push_back(bias);
+        Lanes acc_bias = bias;
+        for (int o = 0; o < N_OUT; o++) {
+            for (int l1 = 0; l1 < L1; l1++) {
+                for (int j = 0; j < 16; j++) acc_bias[j] *= 2;
+                for (int l0 = 0; l0 < L0; l0++) {
+                    Lanes x(16), y(16);
+                    for (int j = 0; j < 16; j++) {
+                        x[j] = 256 * (((int)inputs.size() * 5 + j) % 17 - 8);
+                        y[j] = x[j] + acc_bias[j];
+                    }
+                    inputs.push_back(x);
+                    expect("loop/jmp", o*L0 + l0, ref_out(y));
+                }
+            }
+        }
+        run_program(inputs);
+    }
+
+    // Loop state never outlives its pass, and only a level 0 LOOP changes
+    // the output addressing:
+    //   A: the JMP at the end of the level 0 body replaces its back edge and
+    //      starts output 1 past the LOOP, which must not see a stale loop
+    //        0: LOOP L0, 1..3
+    //        1:   INPE R1
+    //        2:   OUTGB R1     address o*loop_count[0]
+    //        3:   JMP not last -> 1
+    //   B: a wide program without LOOP after it, loop_count[0] left at 3
+    //   C: the same INPE/OUTGB as an 8-bit program, loop_count[0] left at 3
+    // B and C address output_counter
+    void test_loop_state() {
+        const int L0 = 2;
+        std::vector<NVUINT16> prog;
+        prog.push_back(wide_imm(kLoop, 0, 2));
+        prog.push_back(wide(kInpe, 1));
+        prog.push_back(wide(kOutgb, 0, 1));
+        prog.push_back(wide_imm(kJmp, 3, 1));
+        ActCfg cfg(prog.size(), 2);
+        cfg.loop_count[0] = L0;
+        load_program(prog, cfg);
+
+        std::vector<Lanes> inputs;
+        for (int o = 0; o < 2; o++) {
+            Lanes x(16);
+            for (int j = 0; j < 16; j++) x[j] = 256 * ((o * 3 + j) % 11 - 5);
+            inputs.push_back(x);
+            expect("JMP over a loop end", o * L0, ref_out(x));
+        }
+        run_program(inputs);
+
+        const char* names[2] = {"wide without LOOP", "8-bit"};
+        for (int is_wide = 1; is_wide >= 0; is_wide--) {
+            const int N_OUT = 3 - is_wide;
+            prog.clear();
+            if (is_wide) {
+                prog.push_back(wide(kInpe, 1));
+                prog.push_back(wide(kOutgb, 0, 1));
+            }
+            else {
+                prog.push_back(0x34);   // INPE R1
+                prog.push_back(0x44);   // OUTGB R1
+            }
+            ActCfg flat(prog.size(), N_OUT);
+            flat.is_wide = is_wide;
+            flat.loop_count[0] = 3;
+            load_program(prog, flat);
+
+            inputs.clear();
+            for (int o = 0; o < N_OUT; o++) {
+                Lanes x(16);
+                for (int j = 0; j < 16; j++) x[j] = 128 * ((o * 5 + j * 7) % 13 - 6);
+                inputs.push_back(x);
+                expect(std::string("addressing ") + names[1 - is_wide], o, ref_out(x));
+            }
+            run_program(inputs);
+        }
+    }
+
+    // Cross-lane reductions over 3 outputs:
+    //   S0 running sum -> mean with reduce_scale = 1/48 (not a power of two)
+    //   S1 running sum of squares, past the Q4.12 range but inside Q20.20
+    //   S2 running max, the middle output has the smallest maximum
+    // then a second program with FLAGS[1] restart vs accumulate, S emptied by
+    // start, and HGET saturation on both sides of the Q4.12 range
+    void test_reduce() {
+        const int N_OUT = 3, SCALE = 65536 / 48;
+        std::vector<NVUINT16> prog;
+        prog.push_back(wide(kInpe, 1));
+        prog.push_back(wide(kHsum, 0, 1));
+        prog.push_back(wide(kHssq, 1, 1));
+        prog.push_back(wide(kHmax, 2, 1));
+        prog.push_back(wide(kHget, 2, 0, 0, 2));   // R2 = S0 * scale
+        prog.push_back(wide(kOutgb, 0, 2));
+        prog.push_back(wide(kHget, 3, 1, 0, 2));   // R3 = S1 * scale
+        prog.push_back(wide(kOutgb, 0, 3));
+        prog.push_back(wide(kHget, 4, 2));         // R4 = S2
+        prog.push_back(wide(kOutgb, 0, 4));
+        ActCfg cfg(prog.size(), N_OUT);
+        cfg.reduce_scale = SCALE;
+        load_program(prog, cfg);
+
+        const int max_lane[N_OUT] = {6, 2, 7};     // x 256: 1.5, 0.5, 1.75
+        std::vector<Lanes> inputs;
+        long long sum = 0, ssq = 0, max_red = 0;
+        for (int o = 0; o < N_OUT; o++) {
+            Lanes x(16);
+            for (int j = 0; j < 16; j++) x[j] = 512 * ((o * 7 + j * 3) % 9 - 8);    // [-2.0, 0]
+            x[5] = 256 * max_lane[o];
+            inputs.push_back(x);
+            sum += ref_hsum(x, false);
+            ssq += ref_hsum(x, true);
+            max_red = (o == 0) ? ref_hmax(x) : std::max(max_red, ref_hmax(x));
+            expect("HSUM mean", o, ref_out(ref_hget(sum, SCALE, true)));
+            expect("HSSQ mean square", o, ref_out(ref_hget(ssq, SCALE, true)));
+            expect("HMAX running max", o, ref_out(ref_hget(max_red, SCALE, false)));
+        }
+        run_program(inputs);
+
+        std::vector<NVUINT16> prog_b;
+        prog_b.push_back(wide(kInpe, 1));
+        prog_b.push_back(wide(kHsum, 3, 1, 0, 2));   // S3 = sum, restart
+        prog_b.push_back(wide(kHsum, 3, 1));         // S3 += sum
+        prog_b.push_back(wide(kHsum, 0, 1));         // S0 += sum, across outputs
+        prog_b.push_back(wide(kHget, 2, 3));
+        prog_b.push_back(wide(kOutgb, 0, 2));
+        prog_b.push_back(wide(kHget, 3, 0));
+        prog_b.push_back(wide(kOutgb, 0, 3));
+        load_program(prog_b, ActCfg(prog_b.size(), 3));
+
+        // lanes 0.3125, -0.078125, -0.9375: S3 = 10.0 (saturates high), -2.5 (only
+        // if restarted, 7.5 otherwise), -30.0 (saturates low); S0 = 5.0, 3.75, -11.25
+        const int lane_val[3] = {1280, -320, -3840};
+        inputs.clear();
+        sum = 0;
+        for (int o = 0; o < 3; o++) {
+            Lanes x(16, lane_val[o]);
+            inputs.push_back(x);
+            sum += ref_hsum(x, false);
+            expect("HSUM restart", o, ref_out(ref_hget(2 * ref_hsum(x, false), 0, false)));
+            expect("HSUM after start", o, ref_out(ref_hget(sum, 0, false)));
+        }
+        run_program(inputs);
+    }
+
+    // Programmable activation LUT: tables written and read back through
+    // region 0xD, breakpoints every 0.5 from -3.5 to 3.5, inputs on and just
+    // below negative breakpoints, then results past the Q4.12 range that wrap
+    // by default and clamp with FLAGS[0]
+    void test_alut() {
+        Lanes bp(16), slope(16), offset(16);
+        for (int k = 0; k < 16; k++) {
+            bp[k]     = (k - 8) * 2048;       // (k-8)*0.5, bp[0] is ignored
+            slope[k]  = (k - 8) * 1024;       // (k-8)*0.25: -2.0 .. 1.75
+            offset[k] = k * 512 - 4096;       // k*0.125 - 1.0
+        }
+        slope[15] = 3 * 4096;
+        const Lanes* tables[3] = {&bp, &slope, &offset};
+        for (int t = 0; t < 3; t++) {
+            for (int h = 0; h < 2; h++) write(0xD, 2*t + h, pack_half(*tables[t], h));
+        }
+        for (int t = 0; t < 3; t++) {
+            for (int h = 0; h < 2; h++) read(0xD, 2*t + h, "ALUT table read back", pack_half(*tables[t], h));
+        }
+
+        std::vector<NVUINT16> prog;
+        prog.push_back(wide(kInpe, 1));
+        prog.push_back(wide(kAlut, 2, 1));
+        prog.push_back(wide(kOutgb, 0, 2));
+        prog.push_back(wide(kAlut, 3, 1, 0, 1));    // FLAGS[0]: saturate
+        prog.push_back(wide(kOutgb, 0, 3));
+        load_program(prog, ActCfg(prog.size(), 2));
+
+        std::vector<Lanes> inputs(2, Lanes(16));
+        for (int j = 0; j < 16; j++) {
+            inputs[0][j] = (j - 8) * 2048 - (j % 2);    // on, and one LSB below, each breakpoint
+        }
+        const int big[4] = {28672, -32000, 26000, -20480};   // 7.0, -7.8, 6.35, -5.0
+        for (int j = 0; j < 16; j++) inputs[1][j] = big[j % 4] - 256 * (j / 4);
+        for (int o = 0; o < 2; o++) {
+            expect("ALUT wrap", o, ref_out(ref_alut(inputs[o], bp, slope, offset, false)));
+            expect("ALUT saturate", o, ref_out(ref_alut(inputs[o], bp, slope, offset, true)));
+        }
+        run_program(inputs);
+    }
+
+    // Resident parameter bank: vectors written as two 8-lane halves through
+    // region 0xC (local index 2*vector + half) and read back, then two LDPMs
+    // per output with param_stride 0 (every output sees the same pair), 1
+    // (overlapping pairs) and 2 (interleaved a/b pairs, as for norm alpha/beta)
+    void test_params() {
+        const int BASE = 100, N_VEC = 6, N_OUT = 3;
+        std::vector<Lanes> params(N_VEC, Lanes(16));
+        for (int v = 0; v < N_VEC; v++) {
+            for (int j = 0; j < 16; j++) params[v][j] = 256 * ((v * 5 + j * 3) % 15 - 7);    // [-1.75, 1.75]
+            for (int h = 0; h < 2; h++) write(0xC, 2*(BASE + v) + h, pack_half(params[v], h));
+        }
+        for (int v = 0; v < N_VEC; v++) {
+            for (int h = 0; h < 2; h++) read(0xC, 2*(BASE + v) + h, "param bank read back", pack_half(params[v], h));
+        }
+
+        std::vector<NVUINT16> prog;
+        prog.push_back(wide(kLdpm, 1));
+        prog.push_back(wide(kOutgb, 0, 1));
+        prog.push_back(wide(kLdpm, 2));
+        prog.push_back(wide(kOutgb, 0, 2));
+        const char* names[3] = {"LDPM stride 0", "LDPM stride 1", "LDPM stride 2"};
+        for (int stride = 0; stride < 3; stride++) {
+            ActCfg cfg(prog.size(), N_OUT);
+            cfg.param_addr_base = BASE;
+            cfg.param_stride = stride;
+            load_program(prog, cfg);
+            for (int o = 0; o < N_OUT; o++) {
+                expect(names[stride], o, ref_out(params[o*stride]));
+                expect(names[stride], o, ref_out(params[o*stride + 1]));
+            }
+            run_program(std::vector<Lanes>());
+        }
+    }
+
+    // Output formats: the default must be bit identical to the Q4.4
+    // kActOutputPortType conversion (AC_RND, AC_SAT) over rounding ties and
+    // both saturation ends, then a Q1.7 format with a zero point, then an
+    // out_frac of 15 that is clamped to 12 on write
+    void test_out_format() {
+        std::vector<NVUINT16> prog;
+        prog.push_back(wide(kInpe, 1));
+        prog.push_back(wide(kOutgb, 0, 1));
+
+        std::vector<Lanes> inputs(4, Lanes(16));
+        for (int k = 0; k < 64; k++) inputs[k / 16][k % 16] = (k - 32) * 1024 + (k % 4) * 64;
+        inputs[0][0] = -32768; inputs[0][1] = -32767; inputs[3][15] = 32767; inputs[3][14] = 32640;
+        load_program(prog, ActCfg(prog.size(), 4));
+        for (int o = 0; o < 4; o++) {
+            Lanes q44(16);
+            for (int j = 0; j < 16; j++) {
+                spec::Act::kActOutputPortScalar x;
+                x.set_slc(0, (spec::ActScalarType)inputs[o][j]);
+                spec::Act::kActOutputPortType y = x;
+                q44[j] = (int8_t)y.slc<spec::kIntWordWidth>(0).to_int();
+            }
+            expect("default format is Q4.4", o, q44);
+        }
+        run_program(inputs);
+
+        ActCfg cfg(prog.size(), 4);
+        cfg.is_out_format = 1; cfg.out_frac = 7; cfg.out_zero_point = -20;
+        load_program(prog, cfg);
+        for (int o = 0; o < 4; o++) expect("out_frac 7, zero point -20", o, ref_out(inputs[o], 7, -20));
+        run_program(inputs);
+
+        cfg.num_output = 1; cfg.out_frac = 15; cfg.out_zero_point = 5;
+        load_program(prog, cfg);
+        ActCfg cfg_read = cfg;
+        cfg_read.out_frac = spec::kActNumFrac;
+        read(0x8, 0x01, "out_frac clamp read back", cfg_read.bits());
+        std::vector<Lanes> small(1, Lanes(16));
+        for (int j = 0; j < 16; j++) small[0][j] = (j - 8) * 17;
+        expect("out_frac 15 behaves as 12", 0, ref_out(small[0], spec::kActNumFrac, 5));
+        run_program(small);
+    }
+
+    // Overflow of EADD/EMUL/EFMA: the same operands run three times, wrapping
+    // (no saturation), clamped by FLAGS[0] on each instruction, and clamped by
+    // the is_saturate config bit. Lanes 0-3 stay in range and must not change.
+    void test_saturate() {
+        std::vector<Lanes> inputs(3, Lanes(16));
+        unsigned seed = 12345;
+        for (int v = 0; v < 3; v++) {
+            for (int j = 0; j < 16; j++) {
+                seed = seed * 1103515245u + 12345u;
+                inputs[v][j] = (int)((seed >> 8) & 0xFFFF) - 32768;
+                if (j < 4) inputs[v][j] /= 16;          // |x| < 0.5
+            }
+        }
+        inputs[0][4] = 32767;  inputs[1][4] = 32767;    // 8 + 8, 8 * 8
+        inputs[0][5] = -32768; inputs[1][5] = -32768;   // -8 - 8, -8 * -8
+        inputs[0][6] = -32768; inputs[1][6] = 32767;    // -8 * 8
+
+        for (int mode = 0; mode < 3; mode++) {
+            int flags = (mode == 1) ? 1 : 0;
+            bool is_sat = (mode != 0);
+            std::vector<NVUINT16> prog;
+            prog.push_back(wide(kInpe, 1));
+            prog.push_back(wide(kInpe, 2));
+            prog.push_back(wide(kEadd, 4, 1, 2, flags));
+            prog.push_back(wide(kOutgb, 0, 4));
+            prog.push_back(wide(kEmul, 5, 1, 2, flags));
+            prog.push_back(wide(kOutgb, 0, 5));
+            prog.push_back(wide(kInpe, 6));
+            prog.push_back(wide(kEfma, 6, 1, 2, flags));   // R6 = R1*R2 + R6
+            prog.push_back(wide(kOutgb, 0, 6));
+            ActCfg cfg(prog.size(), 1);
+            cfg.is_saturate = (mode == 2);
+            load_program(prog, cfg);
+
+            const char* names[3] = {"wrap", "FLAGS[0] saturate", "is_saturate"};
+            Lanes add(16), mul(16), fma(16);
+            for (int j = 0; j < 16; j++) {
+                long long a = inputs[0][j], b = inputs[1][j], d = inputs[2][j];
+                add[j] = ref_q412(a + b, is_sat);
+                mul[j] = ref_q412((a * b) >> spec::kActNumFrac, is_sat);
+                fma[j] = ref_q412(((a * b) >> spec::kActNumFrac) + d, is_sat);
+            }
+            expect(std::string("EADD ") + names[mode], 0, ref_out(add));
+            expect(std::string("EMUL ") + names[mode], 0, ref_out(mul));
+            expect(std::string("EFMA ") + names[mode], 0, ref_out(fma));
+            run_program(inputs);
+        }
+    }
+
     void run() {
         start.Reset();
         act_port.Reset();
@@ -100,6 +636,91 @@ SC_MODULE(Source) {
         act_port.Push(vec_x);     wait();
         act_port.Push(vec_beta);  wait();
 
+        // ================================================================
+        // Sigmoid gate test (SIGM + ONEX)
+        // Config writes are only popped once the previous program is done
+        // ================================================================
+        // INPE(0x30), SIGM(0xA0), OUTGB(0x40), COPY(0x74), ONEX(0xD4), OUTGB(0x44)
+        NVUINT8 gate_microcode[6] = {0x30, 0xA0, 0x40, 0x74, 0xD4, 0x44};
+
+        inst_data = 0;
+        for (int i = 0; i < 6; i++) {
+            inst_data.set_slc(8 * i, gate_microcode[i]);
+        }
+        axi_write(0x02, inst_data);
+        wait();
+        axi_write(0x01, config_data);
+        wait();
+
+        start.Push(true);
+        wait();
+
+        spec::ActVectorType vec_gate;
+        for (int i = 0; i < N; i++) {
+            vec_gate[i] = (spec::ActScalarType)(int16_t)std::lround(gate_input(i) * 4096.0);
+        }
+        act_port.Push(vec_gate); wait();
+
+        // ================================================================
+        // Wide instruction test: affine norm again, non-destructive over R1-R5
+        // ================================================================
+        // INPE R1, INPE R2, EMUL R4=R1*R2, INPE R3, EADD R5=R4+R3, OUTGB R5
+        NVUINT16 wide_microcode[6] = {0x1900, 0x1A00, 0x4C28, 0x1B00, 0x458C, 0x20A0};
+
+        inst_data = 0;
+        for (int i = 0; i < 6; i++) {
+            inst_data.set_slc(16 * i, wide_microcode[i]);
+        }
+        axi_write(0x04, inst_data);
+        wait();
+        NVUINTW(128) wide_config_data = config_data;
+        wide_config_data.set_slc(16, (NVUINT1)1); // is_wide
+        axi_write(0x01, wide_config_data);
+        wait();
+
+        start.Push(true);
+        wait();
+
+        act_port.Push(vec_alpha); wait();
+        act_port.Push(vec_x);     wait();
+        act_port.Push(vec_beta);  wait();
+
+        // ================================================================
+        // 8-bit EFMA test: affine norm as one fused multiply-add
+        // ================================================================
+        // INPE(0x34), INPE(0x38), INPE(0x3C), EFMA(0x59) R2=R2*R1+R3, OUTGB(0x48)
+        NVUINT8 efma_microcode[5] = {0x34, 0x38, 0x3C, 0x59, 0x48};
+
+        inst_data = 0;
+        for (int i = 0; i < 5; i++) {
+            inst_data.set_slc(8 * i, efma_microcode[i]);
+        }
+        axi_write(0x02, inst_data);
+        wait();
+        NVUINTW(128) efma_config_data = config_data;
+        efma_config_data.set_slc(24, (NVUINT6)5); // num_inst
+        axi_write(0x01, efma_config_data);
+        wait();
+
+        start.Push(true);
+        wait();
+
+        act_port.Push(vec_alpha); wait();
+        act_port.Push(vec_x);     wait();
+        act_port.Push(vec_beta);  wait();
+
+        // ================================================================
+        // Directed wide programs, checked by Sink against expected_outs
+        // ================================================================
+        test_loop_jump();
+        test_loop_state();
+        test_reduce();
+        test_alut();
+        test_params();
+        test_out_format();
+        test_saturate();
+        directed_source_done = true;
+
         while (1) { wait(); }
     }
 };
@@ -175,6 +796,133 @@ SC_MODULE(Sink) {
             std::cout << "FAILED with " << errors << "/" << N << " mismatches." << std::endl;
         }
 
+        done.Pop();
+
+        // Sigmoid PWL is checked to within one Q4.4 LSB of the exact value
+        int gate_errors = 0;
+        spec::StreamType hw_sigm = output_port.Pop();
+        spec::StreamType hw_onex = output_port.Pop();
+        done.Pop();
+
+        std::cout << "\n--- ActUnit Sigmoid Gate Test (SIGM + ONEX) ---" << std::endl;
+        std::cout << std::string(80, '-') << std::endl;
+        std::cout << std::setw(6)  << "Index"
+                  << std::setw(10) << "Input"
+                  << std::setw(12) << "SIGM (HW)"
+                  << std::setw(12) << "SIGM (Ref)"
+                  << std::setw(12) << "ONEX (HW)"
+                  << std::setw(12) << "ONEX (Ref)"
+                  << std::setw(10) << "Status" << std::endl;
+        std::cout << std::string(80, '-') << std::endl;
+
+        for (int i = 0; i < N; i++) {
+            double x   = gate_input(i);
+            double sig = 1.0 / (1.0 + std::exp(-x));
+            int sigm_hw  = (int8_t)hw_sigm.data[i].to_int();
+            int onex_hw  = (int8_t)hw_onex.data[i].to_int();
+            int sigm_ref = to_q4_4(sig);
+            int onex_ref = to_q4_4(1.0 - sig);
+
+            bool match = (std::abs(sigm_hw - sigm_ref) <= 1) &&
+                         (std::abs(onex_hw - onex_ref) <= 1);
+            if (!match) gate_errors++;
+
+            std::cout << std::setw(6)  << i
+                      << std::setw(10) << std::fixed << std::setprecision(2) << x
+                      << std::setw(12) << sigm_hw
+                      << std::setw(12) << sigm_ref
+                      << std::setw(12) << onex_hw
+                      << std::setw(12) << onex_ref
+                      << std::setw(10) << (match ? "OK" : "MISMATCH")
+                      << std::endl;
+        }
+
+        std::cout << std::string(80, '-') << std::endl;
+        if (gate_errors == 0) {
+            std::cout << "SUCCESS: SIGM and ONEX match the reference sigmoid gate!" << std::endl;
+        } else {
+            std::cout << "FAILED with " << gate_errors << "/" << N << " mismatches." << std::endl;
+        }
+
+        // Wide encoding must reproduce the 8-bit affine norm bit for bit
+        int wide_errors = 0;
+        spec::StreamType hw_wide = output_port.Pop();
+        done.Pop();
+        for (int i = 0; i < N; i++) {
+            if ((int8_t)hw_wide.data[i].to_int() != golden_out[i]) wide_errors++;
+        }
+        std::cout << "\n--- ActUnit Wide Instruction Test (3-operand EMUL + EADD) ---" << std::endl;
+        if (wide_errors == 0) {
+            std::cout << "SUCCESS: Wide microcode matches the 8-bit microcode output!" << std::endl;
+        } else {
+            std::cout << "FAILED with " << wide_errors << "/" << N << " mismatches." << std::endl;
+        }
+
+        // 8-bit EFMA rounds once and must match the golden norm as well
+        int efma_errors = 0;
+        spec::StreamType hw_efma = output_port.Pop();
+        done.Pop();
+        for (int i = 0; i < N; i++) {
+            if ((int8_t)hw_efma.data[i].to_int() != golden_out[i]) efma_errors++;
+        }
+        std::cout << "\n--- ActUnit 8-bit EFMA Affine Norm Test ---" << std::endl;
+        if (efma_errors == 0) {
+            std::cout << "SUCCESS: EFMA microcode matches the Bit-Accurate Python Golden Output!" << std::endl;
+        } else {
+            std::cout << "FAILED with " << efma_errors << "/" << N << " mismatches." << std::endl;
+        }
+
+        // Directed programs: outputs, AXI read backs and done pulses in order
+        std::cout << "\n--- ActUnit Directed Programs ---" << std::endl;
+        int directed_errors = 0, programs_done = 0, timeout = 0;
+        while (!(directed_source_done && programs_done == num_directed_programs &&
+                 expected_outs.empty() && expected_reads.empty())) {
+            spec::StreamType out;
+            if (output_port.PopNB(out)) {
+                if (expected_outs.empty()) {
+                    directed_errors++;
+                    std::cout << "  unexpected output at " << out.logical_addr << std::endl;
+                }
+                else {
+                    ExpectedOut e = expected_outs.front();
+                    expected_outs.pop_front();
+                    bool ok = ((int)out.logical_addr == e.addr);
+                    for (int i = 0; i < N; i++) ok &= ((int8_t)out.data[i].to_int() == e.data[i]);
+                    if (!ok) {
+                        directed_errors++;
+                        std::cout << "  " << e.name << " mismatch: HW addr " << out.logical_addr << " data";
+                        for (int i = 0; i < N; i++) std::cout << " " << (int)(int8_t)out.data[i].to_int();
+                        std::cout << " / Ref addr " << e.addr << " data";
+                        for (int i = 0; i < N; i++) std::cout << " " << e.data[i];
+                        std::cout << std::endl;
+                    }
+                }
+            }
+            spec::Axi::SubordinateToRVA::Read rsp;
+            if (rva_out.PopNB(rsp)) {
+                if (expected_reads.empty() || rsp.data != expected_reads.front().second) {
+                    directed_errors++;
+                    std::cout << "  " << (expected_reads.empty() ? "unexpected read" : expected_reads.front().first)
+                              << " mismatch: HW " << std::hex << rsp.data << std::dec << std::endl;
+                }
+                if (!expected_reads.empty()) expected_reads.pop_front();
+            }
+            bool done_reg;
+            if (done.PopNB(done_reg)) programs_done++;
+            if (++timeout > 100000) {
+                directed_errors++;
+                std::cout << "  TIMEOUT: " << expected_outs.size() << " outputs, " << expected_reads.size()
+                          << " reads, " << (num_directed_programs - programs_done) << " done pulses missing" << std::endl;
+                break;
+            }
+            wait();
+        }
+        if (directed_errors == 0) {
+            std::cout << "SUCCESS: all directed programs match the reference!" << std::endl;
+        } else {
+            std::cout << "FAILED with " << directed_errors << " directed mismatches." << std::endl;
+        }
+
         sc_stop();
     }
 };
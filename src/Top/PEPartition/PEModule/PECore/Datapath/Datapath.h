@@ -52,5 +52,50 @@ inline void Datapath(spec::VectorType weight_in[spec::kNumVectorLanes],
   accum_out = accum_out_tmp;
 }
 
+// Transposed weight block: lane c takes element c of every stored row
+inline void TransposeWeights(spec::VectorType weight_in[spec::kNumVectorLanes],
+              spec::VectorType weight_out[spec::kNumVectorLanes])
+{
+  #pragma hls_unroll yes 
+  for (int c = 0; c < spec::kNumVectorLanes; c++) {
+    #pragma hls_unroll yes 
+    for (int k = 0; k < spec::kVectorSize; k++) {
+      weight_out[c][k] = weight_in[k][c];
+    }
+  }
+}
+
+// Int4 mode: each 128-bit word packs 2*kVectorSize signed 4-bit values,
+// one lane does the dot products of both halves in a single cycle
+inline void ProductSumInt4(const spec::VectorType in_1, const spec::VectorType in_2, spec::AccumScalarType& out) {
+  spec::AccumScalarType out_tmp = 0; 
+  NVUINTW(spec::VectorType::width) in_1_bits = in_1.to_rawbits();
+  NVUINTW(spec::VectorType::width) in_2_bits = in_2.to_rawbits();
+  
+  #pragma hls_unroll yes
+  #pragma cluster addtree 
+  #pragma cluster_type both  
+  for (int j = 0; j < 2 * spec::kVectorSize; j++) {
+    spec::HalfType w = nvhls::get_slc<spec::kIntWordWidth/2>(in_1_bits, j * spec::kIntWordWidth/2);
+    spec::HalfType x = nvhls::get_slc<spec::kIntWordWidth/2>(in_2_bits, j * spec::kIntWordWidth/2);
+    out_tmp += w*x;
+  }
+  out = out_tmp;
+}
+
+inline void DatapathInt4(spec::VectorType weight_in[spec::kNumVectorLanes], 
+              spec::VectorType input_in,
+              spec::AccumVectorType& accum_out)
+{
+  spec::AccumVectorType accum_out_tmp; 
+
+  #pragma hls_unroll yes 
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    ProductSumInt4(weight_in[i], input_in, accum_out_tmp[i]);
+  }
+  
+  accum_out = accum_out_tmp;
+}
+
 
 #endif
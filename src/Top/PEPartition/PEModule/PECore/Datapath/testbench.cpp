@@ -67,6 +67,72 @@ CCS_MAIN (int argc, char *argv[]) {
          << "\t\t" << (pass ? "PASS" : "FAIL") << endl;
   }
 
+  // Int4 mode: 32 packed int4 values per word, element 2k in the low nibble
+  // of byte k. The reference works on plain signed integers in [-8, 7] and
+  // packs them by hand, so it shares no slicing code with the DUT.
+  spec::VectorType dp_weight_int4[spec::kNumVectorLanes];
+  spec::VectorType dp_input_int4;
+  spec::AccumVectorType dp_output_int4;
+  long long ref_weight_int4[spec::kNumVectorLanes][2 * spec::kVectorSize];
+  long long ref_input_int4[2 * spec::kVectorSize];
+  long long ref_output_int4[spec::kNumVectorLanes];
+
+  for (int j = 0; j < 2 * spec::kVectorSize; j++) {
+    ref_input_int4[j] = (rand() % 16) - 8;
+  }
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    for (int j = 0; j < 2 * spec::kVectorSize; j++) {
+      ref_weight_int4[i][j] = (rand() % 16) - 8;
+    }
+  }
+  // Extremes: -8 * -8 and 7 * -8 in lane 0
+  ref_input_int4[0] = -8;  ref_weight_int4[0][0] = -8;
+  ref_input_int4[1] = -8;  ref_weight_int4[0][1] = 7;
+
+  for (int k = 0; k < spec::kVectorSize; k++) {
+    int byte = ((ref_input_int4[2*k+1] & 0xF) << 4) | (ref_input_int4[2*k] & 0xF);
+    dp_input_int4[k] = (byte >= 128) ? byte - 256 : byte;
+  }
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    for (int k = 0; k < spec::kVectorSize; k++) {
+      int byte = ((ref_weight_int4[i][2*k+1] & 0xF) << 4) | (ref_weight_int4[i][2*k] & 0xF);
+      dp_weight_int4[i][k] = (byte >= 128) ? byte - 256 : byte;
+    }
+  }
+
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    long long acc = 0;
+    for (int j = 0; j < 2 * spec::kVectorSize; j++) {
+      acc += ref_weight_int4[i][j] * ref_input_int4[j];
+    }
+    ref_output_int4[i] = acc;
+  }
+
+  DatapathInt4(dp_weight_int4, dp_input_int4, dp_output_int4);
+
+  total_tests += spec::kNumVectorLanes;
+  cout << endl << "Int4 Lane\tDUT Output\tRef Output\tStatus" << endl;
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    long long dut_val = (long long) dp_output_int4[i];
+    bool pass = (dut_val == ref_output_int4[i]);
+    if (!pass) failures++;
+    cout << i << "\t" << dut_val << "\t\t" << ref_output_int4[i]
+         << "\t\t" << (pass ? "PASS" : "FAIL") << endl;
+  }
+
+  // TransposeWeights: lane c of the output block is column c of the stored block
+  spec::VectorType dp_weight_t[spec::kNumVectorLanes];
+  TransposeWeights(dp_weight, dp_weight_t);
+  int transpose_failures = 0;
+  for (int c = 0; c < spec::kNumVectorLanes; c++) {
+    for (int k = 0; k < spec::kVectorSize; k++) {
+      if ((long long) dp_weight_t[c][k] != ref_weight[k][c]) transpose_failures++;
+    }
+  }
+  total_tests += 1;
+  if (transpose_failures > 0) failures++;
+  cout << endl << "TransposeWeights	" << (transpose_failures ? "FAIL" : "PASS") << endl;
+
   // Summary
   cout << "\n====================================" << endl;
   cout << "Test Summary: " << (total_tests - failures) << "/" 
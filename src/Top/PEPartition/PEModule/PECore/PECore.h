@@ -63,17 +63,42 @@ public:
     IDLE,   // wait for start signal
     PRE,    // pre-computation setup
     MAC,    // MAC computation
-    SCALE,  // scaling computation
-    OUT     // output results
+    RETIRE  // hand accumulators to the drain pipeline (waits while it is busy)
   };
   FSM state;
 
-  // accumulator regs
-  spec::AccumVectorType accum_vector;
+  // accumulator regs (one set per token of a batch)
+  spec::AccumVectorType accum_vector[spec::PE::kMaxNumBatch];
   spec::ActVectorType act_port_reg;
 
+  // K-tiling: first MAC of a row loads the partial sum instead of adding to zero
+  bool is_row_first;
+  // psum SRAM write is issued the cycle after the row retires
+  bool is_psum_write;
+  spec::PE::Psum::Address psum_write_addr;
+  spec::AccumVectorType psum_write_reg;
+
+  // Drain pipeline: scale/saturate/push of a finished output row
+  // overlaps the MAC of the next row
+  spec::AccumVectorType drain_vector[spec::PE::kMaxNumBatch];
+  bool is_drain_valid;
+  NVUINT4 drain_manager;      // manager of the row being drained
+  NVUINT8 drain_output;       // output index of the row being drained
+  NVUINT3 drain_num_batch;
+  NVUINT3 drain_batch;        // token of the batch pushed next
+  // weight lanes latched on the first token of a batch and reused by the others
+  spec::VectorType weight_reg[spec::kNumVectorLanes];
+
+  // Zero skipping: one bit per physical input SRAM entry, set if the vector is nonzero
+  NVUINTW(spec::PE::Input::kNumBanks * spec::PE::Input::kEntriesPerBank) input_nonzero;
+  // Number of MAC cycles skipped, read at 0x4 local index 0x5, cleared on PEConfig write
+  NVUINT32 zero_skip_count;
+
   // Indicate the Computation part is activated
   bool is_start;
+  // Start pulse popped but not yet consumed by the FSM
+  // (with ping-pong input this seals the fill bank until the swap)
+  bool is_start_pending;
 
   // while loop control signal (including SRAM I/O)
   // True if need to push out AXI response
@@ -106,6 +131,39 @@ public:
       true>
       input_mem;
 
+  // Single port bias SRAM
+  ArbitratedScratchpadDP<
+      spec::PE::Bias::kNumBanks,
+      spec::PE::Bias::kNumReadPorts,
+      spec::PE::Bias::kNumWritePorts,
+      spec::PE::Bias::kEntriesPerBank,
+      spec::PE::Bias::WordType,
+      false,
+      true>
+      bias_mem;
+
+  // Single port per channel scale SRAM
+  ArbitratedScratchpadDP<
+      spec::PE::Scale::kNumBanks,
+      spec::PE::Scale::kNumReadPorts,
+      spec::PE::Scale::kNumWritePorts,
+      spec::PE::Scale::kEntriesPerBank,
+      spec::PE::Scale::WordType,
+      false,
+      true>
+      scale_mem;
+
+  // Single port partial sum SRAM
+  ArbitratedScratchpadDP<
+      spec::PE::Psum::kNumBanks,
+      spec::PE::Psum::kNumReadPorts,
+      spec::PE::Psum::kNumWritePorts,
+      spec::PE::Psum::kEntriesPerBank,
+      spec::PE::Psum::WordType,
+      false,
+      true>
+      psum_mem;
+
   // Weight buffer signals
   // Read address for weight buffer
   spec::PE::Weight::Address weight_read_addrs[spec::PE::Weight::kNumReadPorts];
@@ -151,6 +209,72 @@ public:
   // Read data valid for input buffer
   bool input_port_read_out_valid[spec::PE::Input::kNumReadPorts];
 
+  // Bias Buffer signals
+  // Read address for bias buffer
+  spec::PE::Bias::Address bias_read_addrs[spec::PE::Bias::kNumReadPorts];
+  // Read request valid for bias buffer
+  bool bias_read_req_valid[spec::PE::Bias::kNumReadPorts];
+  // Write address for bias buffer
+  spec::PE::Bias::Address bias_write_addrs[spec::PE::Bias::kNumWritePorts];
+  // Write request valid for bias buffer
+  bool bias_write_req_valid[spec::PE::Bias::kNumWritePorts];
+  // Write data for bias buffer
+  spec::PE::Bias::WordType bias_write_data[spec::PE::Bias::kNumWritePorts];
+  // Read acknowledge for bias buffer
+  bool bias_read_ack[spec::PE::Bias::kNumReadPorts];
+  // Write acknowledge for bias buffer
+  bool bias_write_ack[spec::PE::Bias::kNumWritePorts];
+  // Read ready for bias buffer
+  bool bias_read_ready[spec::PE::Bias::kNumReadPorts];
+  // Read data output for bias buffer
+  spec::PE::Bias::WordType bias_port_read_out[spec::PE::Bias::kNumReadPorts];
+  // Read data valid for bias buffer
+  bool bias_port_read_out_valid[spec::PE::Bias::kNumReadPorts];
+
+  // Scale Buffer signals
+  // Read address for scale buffer
+  spec::PE::Scale::Address scale_read_addrs[spec::PE::Scale::kNumReadPorts];
+  // Read request valid for scale buffer
+  bool scale_read_req_valid[spec::PE::Scale::kNumReadPorts];
+  // Write address for scale buffer
+  spec::PE::Scale::Address scale_write_addrs[spec::PE::Scale::kNumWritePorts];
+  // Write request valid for scale buffer
+  bool scale_write_req_valid[spec::PE::Scale::kNumWritePorts];
+  // Write data for scale buffer
+  spec::PE::Scale::WordType scale_write_data[spec::PE::Scale::kNumWritePorts];
+  // Read acknowledge for scale buffer
+  bool scale_read_ack[spec::PE::Scale::kNumReadPorts];
+  // Write acknowledge for scale buffer
+  bool scale_write_ack[spec::PE::Scale::kNumWritePorts];
+  // Read ready for scale buffer
+  bool scale_read_ready[spec::PE::Scale::kNumReadPorts];
+  // Read data output for scale buffer
+  spec::PE::Scale::WordType scale_port_read_out[spec::PE::Scale::kNumReadPorts];
+  // Read data valid for scale buffer
+  bool scale_port_read_out_valid[spec::PE::Scale::kNumReadPorts];
+
+  // Partial sum buffer signals
+  // Read address for psum buffer
+  spec::PE::Psum::Address psum_read_addrs[spec::PE::Psum::kNumReadPorts];
+  // Read request valid for psum buffer
+  bool psum_read_req_valid[spec::PE::Psum::kNumReadPorts];
+  // Write address for psum buffer
+  spec::PE::Psum::Address psum_write_addrs[spec::PE::Psum::kNumWritePorts];
+  // Write request valid for psum buffer
+  bool psum_write_req_valid[spec::PE::Psum::kNumWritePorts];
+  // Write data for psum buffer
+  spec::PE::Psum::WordType psum_write_data[spec::PE::Psum::kNumWritePorts];
+  // Read acknowledge for psum buffer
+  bool psum_read_ack[spec::PE::Psum::kNumReadPorts];
+  // Write acknowledge for psum buffer
+  bool psum_write_ack[spec::PE::Psum::kNumWritePorts];
+  // Read ready for psum buffer
+  bool psum_read_ready[spec::PE::Psum::kNumReadPorts];
+  // Read data output for psum buffer
+  spec::PE::Psum::WordType psum_port_read_out[spec::PE::Psum::kNumReadPorts];
+  // Read data valid for psum buffer
+  bool psum_port_read_out_valid[spec::PE::Psum::kNumReadPorts];
+
 
   // Constructor
   PECore(sc_module_name nm) :
@@ -177,11 +301,20 @@ public:
   void Reset() {
     state    = IDLE; // reset state
     is_start = 0;    // reset start signal
+    is_start_pending = 0;
     for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
       pe_manager[i].Reset(); // reset PE manager counters
     }
     pe_config.Reset(); // reset PE configuration registers
+    input_nonzero = 0;
+    input_nonzero = ~input_nonzero; // unknown SRAM content must be computed
+    zero_skip_count = 0;
     ResetAccum();      // reset accumulator registers
+    ResetDrain();      // reset drain pipeline
+    is_row_first  = 0;
+    is_psum_write = 0;
+    psum_write_addr = 0;
+    psum_write_reg  = 0;
     ResetPorts();      // reset input/output ports
   } // Reset
 
@@ -196,10 +329,26 @@ public:
 
   // Reset accumulator registers
   void ResetAccum() {
-    accum_vector = 0;
-    act_port_reg = 0;
+#pragma hls_unroll yes
+    for (unsigned b = 0; b < spec::PE::kMaxNumBatch; b++) {
+      accum_vector[b] = 0;
+    }
   } // ResetAccum
 
+  // Reset drain pipeline registers
+  void ResetDrain() {
+#pragma hls_unroll yes
+    for (unsigned b = 0; b < spec::PE::kMaxNumBatch; b++) {
+      drain_vector[b] = 0;
+    }
+    act_port_reg    = 0;
+    is_drain_valid  = 0;
+    drain_manager   = 0;
+    drain_output    = 0;
+    drain_num_batch = 1;
+    drain_batch     = 0;
+  } // ResetDrain
+
   // Reset SRAM buffer interface signals
   void ResetBufferInputs() {
 
@@ -235,9 +384,140 @@ public:
       input_write_data[i]      = 0;
     }
 
+    // Reset all read ports for bias buffer
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::Bias::kNumReadPorts; i++) {
+      bias_read_addrs[i]     = 0;
+      bias_read_req_valid[i] = 0;
+      bias_read_ready[i]     = 0;
+    }
+
+    // Reset all write ports for bias buffer
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::Bias::kNumWritePorts; i++) {
+      bias_write_addrs[i]     = 0;
+      bias_write_req_valid[i] = 0;
+      bias_write_data[i]      = 0;
+    }
+
+    // Reset all read ports for scale buffer
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::Scale::kNumReadPorts; i++) {
+      scale_read_addrs[i]     = 0;
+      scale_read_req_valid[i] = 0;
+      scale_read_ready[i]     = 0;
+    }
+
+    // Reset all write ports for scale buffer
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::Scale::kNumWritePorts; i++) {
+      scale_write_addrs[i]     = 0;
+      scale_write_req_valid[i] = 0;
+      scale_write_data[i]      = 0;
+    }
+
+    // Reset all read ports for psum buffer
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::Psum::kNumReadPorts; i++) {
+      psum_read_addrs[i]     = 0;
+      psum_read_req_valid[i] = 0;
+      psum_read_ready[i]     = 0;
+    }
+
+    // Reset all write ports for psum buffer
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::Psum::kNumWritePorts; i++) {
+      psum_write_addrs[i]     = 0;
+      psum_write_req_valid[i] = 0;
+      psum_write_data[i]      = 0;
+    }
+
   } // ResetBufferInputs
 
 
+  // Each weight partition is a full AXI region
+  spec::PE::Weight::Address GetAxiWeightAddr(const NVUINT4 region, const NVUINT16 local_index) const
+  {
+    spec::PE::Weight::Address addr = local_index;
+    addr.set_slc<1>(spec::PE::Weight::kPartitionWidth, (NVUINT1)(region == 0xB));
+    return addr;
+  }
+
+  // A weight write can run in the background of the FSM when it targets a
+  // partition none of the active managers reads from
+  bool IsBackgroundWeightWrite(const spec::Axi::SubordinateToRVA::Write &rva_in_reg) const
+  {
+    NVUINT4 tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
+    if (!rva_in_reg.rw || (tmp != 0x5 && tmp != 0xB)) {
+      return 0;
+    }
+    NVUINT1 partition = (tmp == 0xB);
+    bool is_busy = 0;
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
+      if (state != IDLE && i < pe_config.num_manager && pe_manager[i].weight_partition == partition) {
+        is_busy = 1;
+      }
+    }
+    return !is_busy;
+  }
+
+  // Host input writes address logical vector local_index (no manager base),
+  // with ping-pong they land in the fill bank like input_port data
+  spec::PE::Input::Address GetAxiInputAddr(const NVUINT16 local_index) const
+  {
+    spec::PE::Input::Address addr = local_index;
+    if (pe_config.is_input_pingpong) {
+      addr = (addr << 1) + pe_config.FillBank();
+    }
+    return addr;
+  }
+
+  // A config that cannot run is rejected: is_valid reads back 0 and start pulses
+  // are ignored until PEConfig is written again. The limits span PEConfig and the
+  // manager registers, so this runs after every region 0x4 write.
+  void CheckConfig()
+  {
+    bool is_ok = 1;
+    // batch mode: B vectors per output row, B tokens back to back per manager
+    NVUINT11 batch_outputs = pe_config.num_batch * pe_config.num_output;
+    if (batch_outputs > spec::PE::kMaxStreamVectors) {
+      is_ok = 0;
+    }
+    // K-tiling: one psum entry per output row, and no psum slot per token,
+    // so a batched layer cannot be K-tiled
+    NVUINT12 num_rows = pe_config.num_output * pe_config.num_manager;
+    bool is_accum = pe_config.IsAccumLoad() || pe_config.IsAccumStore();
+    if (is_accum && num_rows > spec::PE::Psum::kNumBanks * spec::PE::Psum::kEntriesPerBank) {
+      is_ok = 0;
+    }
+    if (is_accum && pe_config.num_batch > 1) {
+      is_ok = 0;
+    }
+    // cluster words hold 4-bit LUT indices of int8 weights, not int4 weights
+    if (pe_config.IsInt4() && pe_config.is_cluster) {
+      is_ok = 0;
+    }
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < spec::PE::kNumPEManagers; i++) {
+      NVUINT11 batch_inputs = pe_config.num_batch * pe_manager[i].num_input;
+      if (i < pe_config.num_manager && batch_inputs > spec::PE::kMaxStreamVectors) {
+        is_ok = 0;
+      }
+      // the layer must not run past the end of the manager's weight partition
+      if (i < pe_config.num_manager && !pe_manager[i].IsWeightInPartition(pe_config.num_output, pe_config.is_cluster)) {
+        is_ok = 0;
+      }
+      // an int4 word is 16x32, not a square block, there is no transpose for it
+      if (i < pe_config.num_manager && pe_manager[i].is_transpose && pe_config.IsInt4()) {
+        is_ok = 0;
+      }
+    }
+    if (!is_ok) {
+      pe_config.is_valid = 0;
+    }
+  }
+
   void DecodeAxiWrite(const spec::Axi::SubordinateToRVA::Write &rva_in_reg)
   {
     NVUINT4 tmp = nvhls::get_slc<4>(rva_in_reg.addr, 20);
@@ -247,17 +527,32 @@ public:
     switch (tmp)
     {
     case 0x4:
-    { // PEconfig
-      switch (local_index)
+    { // PEconfig, manager registers at local_index[7:4] = manager, [3:0] = register
+      NVUINT4 m_index = nvhls::get_slc<4>(local_index, 4);
+      bool is_manager = (nvhls::get_slc<8>(local_index, 8) == 0) && (m_index < spec::PE::kNumPEManagers);
+      switch (nvhls::get_slc<4>(local_index, 0))
       {
       case 0x1:
       {
-        pe_config.PEConfigWrite(rva_in_reg.data);
+        if (local_index == 0x1) {
+          pe_config.PEConfigWrite(rva_in_reg.data);
+          zero_skip_count = 0;
+        }
         break;
       }
       case 0x2:
-      { // manager 0 config
-        pe_manager[0].PEManagerWrite(rva_in_reg.data);
+      { // manager config
+        if (is_manager) pe_manager[m_index].PEManagerWrite(rva_in_reg.data);
+        break;
+      }
+      case 0x3:
+      { // manager cluster LUT
+        if (is_manager) pe_manager[m_index].ClusterWrite(rva_in_reg.data);
+        break;
+      }
+      case 0x4:
+      { // manager requantization
+        if (is_manager) pe_manager[m_index].RequantWrite(rva_in_reg.data);
         break;
       }
       default:
@@ -265,20 +560,37 @@ public:
         break;
       }
       }
+      CheckConfig();
       break;
     }
     case 0x5:
-    { // Weight Buffer
-      weight_write_addrs[0] = local_index;
+    case 0xB:
+    { // Weight Buffer (0x5: partition 0, 0xB: partition 1)
+      weight_write_addrs[0] = GetAxiWeightAddr(tmp, local_index);
       weight_write_req_valid[0] = 1;
       weight_write_data[0] = rva_in_reg.data;
       break;
     }
     case 0x6:
     { // Input Buffer (lock datapath)
-      input_write_addrs[0] = local_index;
+      input_write_addrs[0] = GetAxiInputAddr(local_index);
       input_write_req_valid[0] = 1;
       input_write_data[0] = rva_in_reg.data;
+      input_nonzero[input_write_addrs[0]] = (rva_in_reg.data != 0);
+      break;
+    }
+    case 0x7:
+    { // Bias Buffer
+      bias_write_addrs[0] = local_index;
+      bias_write_req_valid[0] = 1;
+      bias_write_data[0] = rva_in_reg.data;
+      break;
+    }
+    case 0xA:
+    { // Scale Buffer
+      scale_write_addrs[0] = local_index;
+      scale_write_req_valid[0] = 1;
+      scale_write_data[0] = rva_in_reg.data;
       break;
     }
     default:
@@ -305,17 +617,34 @@ public:
       break;
     }
     case 0x4:
-    { // PEconfig
-      switch (local_index)
+    { // PEconfig, manager registers at local_index[7:4] = manager, [3:0] = register
+      NVUINT4 m_index = nvhls::get_slc<4>(local_index, 4);
+      bool is_manager = (nvhls::get_slc<8>(local_index, 8) == 0) && (m_index < spec::PE::kNumPEManagers);
+      switch (nvhls::get_slc<4>(local_index, 0))
       {
       case 0x1:
       {
-        pe_config.PEConfigRead(rva_out_reg.data);
+        if (local_index == 0x1) pe_config.PEConfigRead(rva_out_reg.data);
+        break;
+      }
+      case 0x5:
+      { // zero skipping statistics (read only)
+        if (local_index == 0x5) rva_out_reg.data = zero_skip_count;
         break;
       }
       case 0x2:
-      { // manager 0 config
-        pe_manager[0].PEManagerRead(rva_out_reg.data);
+      { // manager config
+        if (is_manager) pe_manager[m_index].PEManagerRead(rva_out_reg.data);
+        break;
+      }
+      case 0x3:
+      { // manager cluster LUT
+        if (is_manager) pe_manager[m_index].ClusterRead(rva_out_reg.data);
+        break;
+      }
+      case 0x4:
+      { // manager requantization
+        if (is_manager) pe_manager[m_index].RequantRead(rva_out_reg.data);
         break;
       }
       default:
@@ -326,9 +655,10 @@ public:
       break;
     }
     case 0x5:
-    { // Weight Buffer
+    case 0xB:
+    { // Weight Buffer (0x5: partition 0, 0xB: partition 1)
       // w_axir_weight = 1;
-      weight_read_addrs[0] = local_index;
+      weight_read_addrs[0] = GetAxiWeightAddr(tmp, local_index);
       weight_read_req_valid[0] = 1;
       weight_read_ready[0] = 1;
       break;
@@ -336,11 +666,25 @@ public:
     case 0x6:
     { // Input Buffer (lock datapath)
       // w_axir_input = 1;
-      input_read_addrs[0] = local_index;
+      input_read_addrs[0] = GetAxiInputAddr(local_index);
       input_read_req_valid[0] = 1;
       input_read_ready[0] = 1;
       break;
     }
+    case 0x7:
+    { // Bias Buffer
+      bias_read_addrs[0] = local_index;
+      bias_read_req_valid[0] = 1;
+      bias_read_ready[0] = 1;
+      break;
+    }
+    case 0xA:
+    { // Scale Buffer
+      scale_read_addrs[0] = local_index;
+      scale_read_req_valid[0] = 1;
+      scale_read_ready[0] = 1;
+      break;
+    }
     default:
     {
       break;
@@ -372,24 +716,107 @@ public:
     }
   }
 
+  void CheckStart()
+  {
+    // Without ping-pong the start signal is only checked in IDLE state,
+    // with ping-pong it can arrive while the datapath is still busy
+    if (!is_start_pending && (state == IDLE || pe_config.is_input_pingpong))
+    {
+      bool start_reg;
+      if (start.PopNB(start_reg)) {
+        is_start_pending = pe_config.is_valid && start_reg;
+        CDCOUT(sc_time_stamp() << " PECore: " << name() << " Start" << endl, kDebugLevel);
+      }
+    }
+  }
+
+  void RunInput()
+  {
+    // Without ping-pong can only pop message from GB buffer in IDLE state,
+    // with ping-pong the fill bank accepts data until a start pulse seals it
+    bool is_fill_open;
+    if (pe_config.is_input_pingpong) {
+      is_fill_open = !is_start_pending;
+    }
+    else {
+      is_fill_open = (state == IDLE);
+    }
+
+    spec::StreamType input_port_reg;
+    if (is_fill_open && input_port.PopNB(input_port_reg))
+    {
+      NVUINT4 m_index = input_port_reg.index;
+      input_write_addrs[0] = pe_manager[m_index].GetInputAddr(
+          input_port_reg.logical_addr, pe_config.FillBank(), pe_config.is_input_pingpong);
+      input_write_req_valid[0] = 1;
+      input_write_data[0] = input_port_reg.data;
+      input_nonzero[input_write_addrs[0]] = (input_port_reg.data.to_rawbits() != 0);
+    }
+  }
+
+  // Look ahead from the current input index and count the zero input vectors
+  // in front of the next nonzero one (at most kZeroSkipWindow)
+  NVUINT8 CountZeroInputs() const
+  {
+    NVUINT4 m_index = pe_config.ManagerIndex();
+    NVUINT8 skip_count = 0;
+    bool is_found = 0;
+#pragma hls_unroll yes
+    for (unsigned k = 0; k < spec::PE::kZeroSkipWindow; k++)
+    {
+      NVUINT16 input_index = pe_config.InputIndex() + k;
+      spec::PE::Input::Address addr = pe_manager[m_index].GetInputAddr(
+          input_index, pe_config.InputBank(), pe_config.is_input_pingpong);
+      if (!is_found)
+      {
+        if (input_index >= pe_manager[m_index].num_input || input_nonzero[addr] == 1) {
+          is_found = 1;
+        }
+        else {
+          skip_count += 1;
+        }
+      }
+    }
+    return skip_count;
+  }
+
+  // Skip zero input vectors before the next MAC, is_input_end if none is left
+  void SkipZeroInputs(bool& is_input_end)
+  {
+    is_input_end = 0;
+    NVUINT8 skip_count = CountZeroInputs();
+    if (skip_count != 0) {
+      NVUINT4 m_index = pe_config.ManagerIndex();
+      pe_config.SkipInputCounter(pe_manager[m_index].num_input, skip_count, is_input_end);
+      zero_skip_count += skip_count;
+    }
+  }
+
   void RunFSM()
   {
     // Can do FSM only when and no Axi on input
     // Can only move forward to computation if is_start = 1
-    // Can only pop message from GB buffer in IDLE state
+
+    // spill of the previously retired row
+    if (is_psum_write) {
+      psum_write_addrs[0] = psum_write_addr;
+      psum_write_req_valid[0] = 1;
+      psum_write_data[0] = psum_write_reg;
+      is_psum_write = 0;
+    }
+
+    // partial sum of the current row, used by its first MAC
+    // (or directly by RETIRE if the row has no MAC)
+    if (pe_config.IsAccumLoad() && is_row_first && (state == MAC || state == RETIRE)) {
+      psum_read_addrs[0] = pe_config.RowIndex();
+      psum_read_req_valid[0] = 1;
+      psum_read_ready[0] = 1;
+    }
 
     switch (state)
     {
     case IDLE:
     {
-      spec::StreamType input_port_reg;
-      if (input_port.PopNB(input_port_reg))
-      {
-        NVUINT4 m_index = input_port_reg.index;
-        input_write_addrs[0] = pe_manager[m_index].GetInputAddr(input_port_reg.logical_addr);
-        input_write_req_valid[0] = 1;
-        input_write_data[0] = input_port_reg.data;
-      }
       break;
     }
     case PRE:
@@ -400,30 +827,33 @@ public:
     {
       NVUINT4 m_index = pe_config.ManagerIndex();
       // Do MAC (Datapath)
-      // set weight SRAM read
-      spec::PE::Weight::Address weight_base;      
-        weight_base = pe_manager[m_index].GetWeightAddr(pe_config.InputIndex(), pe_config.OutputIndex(), 0);
+      // set weight SRAM read, only the first token of a batch fetches weights
+      // cluster mode only needs 8 words (two index rows per word)
+      if (pe_config.BatchIndex() == 0) {
+        spec::PE::Weight::Address weight_base;
+        weight_base = pe_manager[m_index].GetWeightAddr(pe_config.InputIndex(), pe_config.OutputIndex(), pe_config.is_cluster);
 #pragma hls_unroll yes
         for (int i = 0; i < spec::kNumVectorLanes; i++)
         {
+          bool is_lane_read = !pe_config.is_cluster || (i < spec::kNumVectorLanes / 2);
           weight_read_addrs[i] = weight_base + i;
-          weight_read_req_valid[i] = 1;
-          weight_read_ready[i] = 1;
+          weight_read_req_valid[i] = is_lane_read;
+          weight_read_ready[i] = is_lane_read;
         }
+      }
       
-      // set input SRAM read
+      // set input SRAM read, tokens of a batch are stored back to back
+      spec::PE::Weight::Address input_index =
+          pe_config.BatchIndex() * pe_manager[m_index].num_input + pe_config.InputIndex();
       input_read_ready[0] = 1;
-      input_read_addrs[0] = pe_manager[m_index].GetInputAddr(pe_config.InputIndex());
+      input_read_addrs[0] = pe_manager[m_index].GetInputAddr(
+          input_index, pe_config.InputBank(), pe_config.is_input_pingpong);
       input_read_req_valid[0] = 1;
 
       break;
     }
 
-    case SCALE:
-    {
-      break;
-    }
-    case OUT:
+    case RETIRE:
     {
       break;
     }
@@ -435,6 +865,26 @@ public:
     }
   }
 
+  // Drain pipeline SRAM reads, bias and scale SRAM are only used here
+  void RunDrain()
+  {
+    if (is_drain_valid)
+    {
+      // set bias SRAM read, one bias vector per output row
+      if (pe_config.is_bias) {
+        bias_read_addrs[0] = pe_manager[drain_manager].GetBiasAddr(drain_output);
+        bias_read_req_valid[0] = 1;
+        bias_read_ready[0] = 1;
+      }
+      // set scale SRAM read, one multiplier per output channel
+      if (pe_manager[drain_manager].is_channel_scale) {
+        scale_read_addrs[0] = pe_manager[drain_manager].GetScaleAddr(drain_output);
+        scale_read_req_valid[0] = 1;
+        scale_read_ready[0] = 1;
+      }
+    }
+  }
+
   void BufferAccess()
   {
     weight_mem.run(
@@ -459,6 +909,39 @@ public:
         input_read_ready,
         input_port_read_out,
         input_port_read_out_valid);
+    bias_mem.run(
+        bias_read_addrs,
+        bias_read_req_valid,
+        bias_write_addrs,
+        bias_write_req_valid,
+        bias_write_data,
+        bias_read_ack,
+        bias_write_ack,
+        bias_read_ready,
+        bias_port_read_out,
+        bias_port_read_out_valid);
+    scale_mem.run(
+        scale_read_addrs,
+        scale_read_req_valid,
+        scale_write_addrs,
+        scale_write_req_valid,
+        scale_write_data,
+        scale_read_ack,
+        scale_write_ack,
+        scale_read_ready,
+        scale_port_read_out,
+        scale_port_read_out_valid);
+    psum_mem.run(
+        psum_read_addrs,
+        psum_read_req_valid,
+        psum_write_addrs,
+        psum_write_req_valid,
+        psum_write_data,
+        psum_read_ack,
+        psum_write_ack,
+        psum_read_ready,
+        psum_port_read_out,
+        psum_port_read_out_valid);
   }
 
   void RunMac()
@@ -468,23 +951,63 @@ public:
       spec::VectorType dp_in0[spec::kNumVectorLanes]; // weight lanes
       spec::VectorType dp_in1; // input vector
       spec::AccumVectorType dp_out; // Datapath output
+      NVUINT3 b_index = pe_config.BatchIndex();
       
+      if (b_index == 0) {
+        NVUINT4 m_index = pe_config.ManagerIndex();
+        if (pe_config.is_cluster) {
+          // decompress the 4-bit indices through the cluster LUT
 #pragma hls_unroll yes
-        for (int i = 0; i < spec::kNumVectorLanes; i++)
-        {
-          dp_in0[i] = weight_port_read_out[i];
-          //cout << "PECore: " << name() << " MAC dp_in0[" << i << "] = " << dp_in0[i] << endl;
+          for (int i = 0; i < spec::kNumVectorLanes / 2; i++)
+          {
+            pe_manager[m_index].ClusterExpand(weight_port_read_out[i], weight_reg[2 * i], weight_reg[2 * i + 1]);
+          }
+        }
+        else {
+#pragma hls_unroll yes
+          for (int i = 0; i < spec::kNumVectorLanes; i++)
+          {
+            weight_reg[i] = weight_port_read_out[i];
+          }
         }
+        // consume the stored block as W^T (int8 and cluster blocks, int4 + transpose is rejected by CheckConfig)
+        if (pe_manager[m_index].is_transpose && !pe_config.IsInt4()) {
+          spec::VectorType weight_tmp[spec::kNumVectorLanes];
+#pragma hls_unroll yes
+          for (int i = 0; i < spec::kNumVectorLanes; i++)
+          {
+            weight_tmp[i] = weight_reg[i];
+          }
+          TransposeWeights(weight_tmp, weight_reg);
+        }
+      }
+#pragma hls_unroll yes
+      for (int i = 0; i < spec::kNumVectorLanes; i++)
+      {
+        dp_in0[i] = weight_reg[i];
+        //cout << "PECore: " << name() << " MAC dp_in0[" << i << "] = " << dp_in0[i] << endl;
+      }
       
       dp_in1 = input_port_read_out[0];
       //cout << "PECore: " << name() << " MAC dp_in1 = " << dp_in1 << endl;
 
-      Datapath(dp_in0, dp_in1, dp_out);
+      // int4 mode covers 32 input elements per cycle, num_input counts 32-wide words
+      if (pe_config.IsInt4()) {
+        DatapathInt4(dp_in0, dp_in1, dp_out);
+      }
+      else {
+        Datapath(dp_in0, dp_in1, dp_out);
+      }
 
 #pragma hls_unroll yes
       for (int i = 0; i < spec::kNumVectorLanes; i++)
       {
-        accum_vector[i] += dp_out[i];
+        if (is_row_first && pe_config.IsAccumLoad()) {
+          accum_vector[b_index][i] = psum_port_read_out[0][i] + dp_out[i];
+        }
+        else {
+          accum_vector[b_index][i] += dp_out[i];
+        }
         //cout << "PECore: " << name() << " MAC accum_vector[" << i << "] = " << accum_vector[i] << endl;
       }
 
@@ -494,16 +1017,26 @@ public:
 
   void RunScale()
   {
-    if (state == SCALE)
+    if (is_drain_valid)
     {
 
-      NVUINT8 scale = spec::kAccumScale;
-      NVUINT8 right_shift = spec::kAccumShift;
+      NVUINT4 m_index = drain_manager;
+      NVUINT5 right_shift = pe_manager[m_index].accum_shift;
+      NVUINT3 b_index = drain_batch;
       spec::AccumVectorType accum_vector_out;
 #pragma hls_unroll yes
       for (int i = 0; i < spec::kNumVectorLanes; i++)
       {
-        accum_vector_out[i] = (accum_vector[i] * scale) >> right_shift;
+        // per layer multiplier, or per output channel from scale SRAM
+        NVUINT8 scale = pe_manager[m_index].is_channel_scale ?
+            scale_port_read_out[0][i] : pe_manager[m_index].accum_scale;
+        accum_vector_out[i] = (drain_vector[b_index][i] * scale) >> right_shift;
+
+        // Bias is int8 Q4.4, align it to the Q4.12 activation word before saturation
+        if (pe_config.is_bias) {
+          spec::AccumScalarType bias = bias_port_read_out[0][i];
+          accum_vector_out[i] += bias << (spec::kActNumFrac - 4);
+        }
 
         // Do overflow checking and cutting
         if (accum_vector_out[i] > spec::kActWordMax)
@@ -519,9 +1052,19 @@ public:
 
   void PushOutput()
   {
-    if (state == OUT)
+    // Non-blocking so a stalled act_port never stalls the MAC,
+    // one token of the batch per successful push
+    if (is_drain_valid)
     {
-      act_port.Push(act_port_reg);
+      if (act_port.PushNB(act_port_reg)) {
+        if (drain_batch >= (drain_num_batch - 1)) {
+          drain_batch = 0;
+          is_drain_valid = 0;
+        }
+        else {
+          drain_batch += 1;
+        }
+      }
     }
   }
 
@@ -539,10 +1082,92 @@ public:
       {
         rva_out_reg.data = input_port_read_out[0].to_rawbits();
       }
+      else if (bias_port_read_out_valid[0])
+      {
+        rva_out_reg.data = bias_port_read_out[0].to_rawbits();
+      }
+      else if (scale_port_read_out_valid[0])
+      {
+        rva_out_reg.data = scale_port_read_out[0].to_rawbits();
+      }
       rva_out.Push(rva_out_reg);
     }
   }
 
+  // Reset accumulators for the next output row, skip its MAC if possible
+  void PrepareRow(FSM& next_state)
+  {
+    ResetAccum();
+    is_row_first = 1;
+    NVUINT4 m_index = pe_config.ManagerIndex();
+    if (pe_manager[m_index].zero_active && pe_config.is_zero_first)
+    {
+      // skip MAC
+      next_state = RETIRE;
+    }
+    else
+    {
+      // zero skipping may leave nothing to compute
+      bool is_input_end = 0;
+      if (pe_config.IsZeroSkip()) {
+        SkipZeroInputs(is_input_end);
+      }
+      next_state = is_input_end ? RETIRE : MAC;
+    }
+  }
+
+  // Hand the finished row to the drain pipeline and go on with the next row
+  // in the same cycle, so MAC continues back to back across output rows
+  void RetireRow(FSM& next_state)
+  {
+    bool is_store = pe_config.IsAccumStore();
+    if (!is_store && is_drain_valid)
+    {
+      // drain pipeline still busy with the previous row
+      next_state = RETIRE;
+    }
+    else
+    {
+      // a row without MAC still carries its partial sum
+      if (is_row_first && pe_config.IsAccumLoad()) {
+        accum_vector[0] = psum_port_read_out[0];
+      }
+      is_row_first = 0;
+
+      if (is_store) {
+        // K tile not finished, spill instead of output
+        is_psum_write   = 1;
+        psum_write_addr = pe_config.RowIndex();
+        psum_write_reg  = accum_vector[0];
+      }
+      else {
+#pragma hls_unroll yes
+        for (unsigned b = 0; b < spec::PE::kMaxNumBatch; b++) {
+          drain_vector[b] = accum_vector[b];
+        }
+        drain_manager   = pe_config.ManagerIndex();
+        drain_output    = pe_config.OutputIndex();
+        drain_num_batch = pe_config.num_batch;
+        drain_batch     = 0;
+        is_drain_valid  = 1;
+      }
+
+      bool is_output_end = 0;
+      pe_config.UpdateManagerCounter(is_output_end);
+      if (is_output_end)
+      {
+        // drain of the last row completes on its own
+        next_state = IDLE;
+        CDCOUT(sc_time_stamp() << " PECore: " << name() << " Finish" << endl, kDebugLevel);
+      }
+      else
+      {
+        PrepareRow(next_state);
+        CDCOUT(sc_time_stamp() << " PECore: " << name() << "next state = " << next_state << endl, kDebugLevel);
+      }
+    }
+  }
+
   // Update FSM State and PE_config counters
   void UpdateFSM()
   {
@@ -551,40 +1176,37 @@ public:
     {
     case IDLE:
     {
-      // Check start signal only in IDLE state
-      bool start_reg;
-      is_start = 0; // reset is_start
-      if (start.PopNB(start_reg)) {
-        is_start = pe_config.is_valid && start_reg;
-        CDCOUT(sc_time_stamp() << " PECore: " << name() << " Start" << endl, kDebugLevel);
+      // Consume the start signal latched by CheckStart
+      is_start = is_start_pending;
+      if (is_start) {
+        is_start_pending = 0;
+        pe_config.SwapInputBank();
       }
       next_state = is_start ? PRE : IDLE;
       break;
     }
     case PRE:
     {
-      ResetAccum();
-      NVUINT4 m_index = pe_config.ManagerIndex();
-      if (pe_manager[m_index].zero_active && pe_config.is_zero_first)
-      {
-        // skip MAC
-        next_state = SCALE;
-      }
-      else
-      {
-        next_state = MAC;
-      }
+      PrepareRow(next_state);
       break;
     }
 
     case MAC:
     {
       NVUINT4 m_index = pe_config.ManagerIndex();
+      is_row_first = 0;  // partial sum consumed by RunMac
+      bool is_batch_end = 0;
       bool is_input_end = 0;
-      pe_config.UpdateInputCounter(pe_manager[m_index].num_input, is_input_end);
+      pe_config.UpdateBatchCounter(is_batch_end);
+      if (is_batch_end) {
+        pe_config.UpdateInputCounter(pe_manager[m_index].num_input, is_input_end);
+      }
+      if (!is_input_end && pe_config.IsZeroSkip()) {
+        SkipZeroInputs(is_input_end);
+      }
       if (is_input_end)
       {
-        next_state = SCALE;
+        RetireRow(next_state);
       }
       else
       {
@@ -592,26 +1214,9 @@ public:
       }
       break;
     }
-    case SCALE:
+    case RETIRE:
     {
-      next_state = OUT;
-      break;
-    }
-
-    case OUT:
-    {
-      bool is_output_end = 0;
-      pe_config.UpdateManagerCounter(is_output_end);
-      if (is_output_end)
-      {
-        next_state = IDLE;
-        CDCOUT(sc_time_stamp() << " PECore: " << name() << " Finish" << endl, kDebugLevel);
-      }
-      else
-      {
-        next_state = PRE;
-        CDCOUT(sc_time_stamp() << " PECore: " << name() << "next state = " << next_state << endl, kDebugLevel);
-      }
+      RetireRow(next_state);
       break;
     }
     default:
@@ -631,9 +1236,14 @@ public:
     while (1) {
       Initialize();
 
-      // Decode AXI requests with highest priority (mutually exclusive with FSM)
-      if (rva_in.PopNB(rva_in_reg)) {
+      // Decode AXI requests with highest priority (mutually exclusive with FSM),
+      // except weight writes to an idle partition which use the weight write port only
+      bool is_axi = rva_in.PopNB(rva_in_reg);
+      bool is_background = is_axi && IsBackgroundWeightWrite(rva_in_reg);
+      if (is_axi) {
         CDCOUT(sc_time_stamp() << " PECore: " << name() << "RVA Pop " << endl, kDebugLevel);
+      }
+      if (is_axi && !is_background) {
         if (rva_in_reg.rw) {
           DecodeAxiWrite(rva_in_reg);
         } else {
@@ -641,10 +1251,16 @@ public:
         }
         BufferAccess();
       } else {
+        if (is_background) {
+          DecodeAxiWrite(rva_in_reg);
+        }
         // Only run FSM when no AXI request is pending
-        // Can only pop message from GB buffer in IDLE state (handled in RunFSM)
+        // Start must be checked before input so a start pulse seals the fill bank
         // Can only move forward to computation if is_start = 1 (handled in UpdateFSM)
+        CheckStart();
+        RunInput();
         RunFSM();
+        RunDrain();
         BufferAccess();
         RunMac();
         RunScale();
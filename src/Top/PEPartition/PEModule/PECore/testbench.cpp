@@ -5,6 +5,7 @@
 #include <fstream>
 #include <vector>
 #include <iomanip>
+#include <cstdlib>
 
 #include "PECore.h"
 #include "../ActUnit/ActUnit.h"
@@ -22,6 +23,663 @@ void load_bin(const char* filename, std::vector<T>& buffer, size_t size) {
     file.close();
 }
 
+// =============================================================================
+// Directed PECore cases on a separate instance, each checked against a plain
+// integer reference before the FC1 layer runs
+// =============================================================================
+
+typedef std::vector<int> RefVec;               // 16 lanes
+typedef std::vector<RefVec> RefMat;            // [16*rows][16*cols] logical weights
+
+int  directed_errors = 0;
+bool directed_done   = false;
+
+// Manager registers (0x4 local index m2 and m4)
+struct ManagerCfg {
+    int num_input, base_weight, base_bias, base_input, partition;
+    int is_transpose, stride_out, stride_in;
+    int accum_scale, accum_shift, is_channel_scale, base_scale;
+    ManagerCfg(int n = 1) : num_input(n), base_weight(0), base_bias(0), base_input(0), partition(0),
+        is_transpose(0), stride_out(0), stride_in(0), accum_scale(spec::kAccumScale),
+        accum_shift(spec::kAccumShift), is_channel_scale(0), base_scale(0) {}
+};
+
+// PEConfig register (0x4 local index 1)
+struct PECfg {
+    int num_manager, num_output, is_cluster, is_bias, is_pingpong, num_batch;
+    int is_zero_skip, is_int4, is_accum_load, is_accum_store;
+    PECfg(int n = 1) : num_manager(1), num_output(n), is_cluster(0), is_bias(0), is_pingpong(0),
+        num_batch(1), is_zero_skip(0), is_int4(0), is_accum_load(0), is_accum_store(0) {}
+    NVUINTW(128) bits() const {
+        NVUINTW(128) d = 0;
+        d.set_slc(0, (NVUINT1)1);               d.set_slc(16, (NVUINT1)is_cluster);
+        d.set_slc(24, (NVUINT1)is_bias);        d.set_slc(32, (NVUINT4)num_manager);
+        d.set_slc(40, (NVUINT8)num_output);     d.set_slc(48, (NVUINT1)is_pingpong);
+        d.set_slc(56, (NVUINT3)num_batch);      d.set_slc(64, (NVUINT1)is_zero_skip);
+        d.set_slc(72, (NVUINT1)is_int4);        d.set_slc(80, (NVUINT1)is_accum_load);
+        d.set_slc(88, (NVUINT1)is_accum_store);
+        return d;
+    }
+};
+
+RefVec rand_vec(int lo, int hi) {
+    RefVec v(16);
+    for (int j = 0; j < 16; j++) v[j] = lo + rand() % (hi - lo + 1);
+    return v;
+}
+
+RefMat rand_mat(int rows, int cols, int lo, int hi) {
+    RefMat w(rows);
+    for (int r = 0; r < rows; r++) {
+        w[r].resize(cols);
+        for (int c = 0; c < cols; c++) w[r][c] = lo + rand() % (hi - lo + 1);
+    }
+    return w;
+}
+
+// Lane j of an int8 vector in [8j+7:8j]
+NVUINTW(128) pack_vec(const RefVec& v) {
+    NVUINTW(128) d = 0;
+    for (int j = 0; j < 16; j++) d.set_slc(8*j, (NVUINT8)(v[j] & 0xFF));
+    return d;
+}
+
+// 32 int4 values as 16 int8 lanes, element 2k in the low nibble of lane k
+RefVec pack_int4(const RefVec& v) {
+    RefVec lanes(16);
+    for (int k = 0; k < 16; k++) {
+        int byte = ((v[2*k + 1] & 0xF) << 4) | (v[2*k] & 0xF);
+        lanes[k] = (byte >= 128) ? byte - 256 : byte;
+    }
+    return lanes;
+}
+
+// Accumulator of output block o: plain dot products of 16 weight rows with the inputs
+std::vector<long long> ref_gemv(const RefMat& w, const std::vector<RefVec>& x, int o) {
+    std::vector<long long> acc(16, 0);
+    for (int c = 0; c < 16; c++) {
+        for (unsigned k = 0; k < 16 * x.size(); k++) {
+            acc[c] += (long long)w[o*16 + c][k] * x[k / 16][k % 16];
+        }
+    }
+    return acc;
+}
+
+// PECore drain: scale and shift, Q4.4 bias aligned to Q4.12, clamp to the act word
+RefVec ref_requant(const std::vector<long long>& acc, const RefVec& scale, int shift,
+                   const RefVec* bias) {
+    RefVec out(16);
+    for (int c = 0; c < 16; c++) {
+        long long v = (acc[c] * scale[c]) >> shift;
+        if (bias) v += (long long)(*bias)[c] << 8;
+        if (v > spec::kActWordMax) v = spec::kActWordMax;
+        if (v < spec::kActWordMin) v = spec::kActWordMin;
+        out[c] = (int)v;
+    }
+    return out;
+}
+
+RefVec ref_layer_row(const RefMat& w, const std::vector<RefVec>& x, int o, const ManagerCfg& mc) {
+    return ref_requant(ref_gemv(w, x, o), RefVec(16, mc.accum_scale), mc.accum_shift, NULL);
+}
+
+// Zero input vectors in front of index idx, at most one look-ahead window
+int ref_lead_zeros(const std::vector<bool>& is_zero, int idx) {
+    int k = 0;
+    while (k < (int)spec::PE::kZeroSkipWindow && idx + k < (int)is_zero.size() && is_zero[idx + k]) k++;
+    return k;
+}
+
+// MAC cycles skipped for one output row: a skip before the first MAC and after each MAC
+int ref_zero_skips(const std::vector<bool>& is_zero) {
+    int n = is_zero.size(), idx = 0, total = 0;
+    int k = ref_lead_zeros(is_zero, idx); total += k; idx += k;
+    while (idx < n) {
+        idx++;
+        if (idx < n) { k = ref_lead_zeros(is_zero, idx); total += k; idx += k; }
+    }
+    return total;
+}
+
+SC_MODULE(DirectedPE) {
+    sc_in<bool> clk, rst;
+
+    Connections::Out<bool> pe_start;
+    Connections::Out<spec::StreamType> pe_in;
+    Connections::Out<spec::Axi::SubordinateToRVA::Write> pe_rva_in;
+    Connections::In<spec::Axi::SubordinateToRVA::Read> pe_rva_out;
+    Connections::In<spec::ActVectorType> pe_out;
+
+    SC_CTOR(DirectedPE) { SC_THREAD(run); sensitive << clk.pos(); async_reset_signal_is(rst, false); }
+
+    void axi_write(int region, int local_index, const NVUINTW(128)& data) {
+        spec::Axi::SubordinateToRVA::Write cmd; cmd.rw = 1;
+        cmd.addr = ((NVUINTW(24))region << 20) | ((NVUINTW(24))local_index << 4);
+        cmd.data = data; pe_rva_in.Push(cmd); wait();
+    }
+
+    NVUINTW(128) axi_read(int region, int local_index) {
+        spec::Axi::SubordinateToRVA::Write cmd; cmd.rw = 0;
+        cmd.addr = ((NVUINTW(24))region << 20) | ((NVUINTW(24))local_index << 4);
+        cmd.data = 0; pe_rva_in.Push(cmd);
+        spec::Axi::SubordinateToRVA::Read rsp = pe_rva_out.Pop();
+        return rsp.data;
+    }
+
+    void write_manager(int m, const ManagerCfg& mc) {
+        NVUINTW(128) d = 0;
+        d.set_slc(4, (NVUINT1)mc.partition);      d.set_slc(8, (NVUINT8)mc.num_input);
+        d.set_slc(16, (NVUINT16)mc.base_weight);  d.set_slc(32, (NVUINT16)mc.base_bias);
+        d.set_slc(48, (NVUINT16)mc.base_input);   d.set_slc(64, (NVUINT1)mc.is_transpose);
+        d.set_slc(72, (NVUINT8)mc.stride_out);    d.set_slc(80, (NVUINT8)mc.stride_in);
+        axi_write(0x4, (m << 4) | 0x2, d);
+        NVUINTW(128) r = 0;
+        r.set_slc(0, (NVUINT8)mc.accum_scale);    r.set_slc(8, (NVUINT5)mc.accum_shift);
+        r.set_slc(16, (NVUINT1)mc.is_channel_scale); r.set_slc(24, (NVUINT8)mc.base_scale);
+        axi_write(0x4, (m << 4) | 0x4, r);
+    }
+
+    void write_pe_config(const PECfg& pc) {
+        axi_write(0x4, 0x1, pc.bits()); wait(2);
+    }
+
+    // is_valid of the PEConfig readback, cleared when a config is rejected
+    bool pe_config_valid() {
+        return nvhls::get_slc<1>(axi_read(0x4, 0x1), 0) == 1;
+    }
+
+    // Row major blocks: block (r, c) of w at (r*cols + c)*16 + base, lane k of a
+    // block is weight row r*16+k
+    void load_weights(const RefMat& w, int base, int partition = 0) {
+        int rows = w.size() / 16, cols = w[0].size() / 16;
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) {
+                for (int k = 0; k < 16; k++) {
+                    RefVec lane(w[r*16 + k].begin() + c*16, w[r*16 + k].begin() + c*16 + 16);
+                    axi_write(partition ? 0xB : 0x5, (r*cols + c)*16 + k + base, pack_vec(lane));
+                }
+            }
+        }
+    }
+
+    // input_port vectors of manager m at logical address offset + i
+    void stream_inputs(const std::vector<RefVec>& x, int m, int offset = 0) {
+        for (unsigned i = 0; i < x.size(); i++) {
+            spec::StreamType st;
+            for (int j = 0; j < 16; j++) st.data[j] = x[i][j];
+            st.index = m; st.logical_addr = offset + i;
+            pe_in.Push(st); wait();
+        }
+    }
+
+    void check_row(const char* name, int row, const RefVec& expected) {
+        spec::ActVectorType hw = pe_out.Pop();
+        bool ok = true;
+        for (int c = 0; c < 16; c++) ok &= ((int)hw[c].to_int() == expected[c]);
+        if (!ok) {
+            directed_errors++;
+            std::cout << "  " << name << " row " << row << " mismatch: HW=";
+            for (int c = 0; c < 16; c++) std::cout << (int)hw[c].to_int() << " ";
+            std::cout << " Ref=";
+            for (int c = 0; c < 16; c++) std::cout << expected[c] << " ";
+            std::cout << std::endl;
+        }
+    }
+
+    void check(const char* name, bool ok) {
+        if (!ok) { directed_errors++; std::cout << "  " << name << " FAILED" << std::endl; }
+    }
+
+    // Two back to back layers with ping-pong input: layer B is streamed while
+    // layer A computes, then PEConfig is rewritten between the layers, which must
+    // keep the prefetched bank. Layer C is host loaded through region 0x6.
+    void test_pingpong() {
+        std::cout << "Directed: ping-pong input, back to back layers" << std::endl;
+        const int N_IN = 2;
+        RefMat w_a = rand_mat(3*16, N_IN*16, -8, 7), w_b = rand_mat(2*16, N_IN*16, -8, 7);
+        std::vector<RefVec> x_a, x_b, x_c;
+        for (int i = 0; i < N_IN; i++) {
+            x_a.push_back(rand_vec(-16, 15)); x_b.push_back(rand_vec(-16, 15)); x_c.push_back(rand_vec(-16, 15));
+        }
+        load_weights(w_a, 0);
+        load_weights(w_b, 0x100);
+
+        ManagerCfg mc_a(N_IN), mc_b(N_IN);
+        mc_b.base_weight = 0x100;
+        PECfg pc_a(3), pc_b(2);
+        pc_a.is_pingpong = 1; pc_b.is_pingpong = 1;
+
+        write_manager(0, mc_a); write_pe_config(pc_a);
+        stream_inputs(x_a, 0);
+        pe_start.Push(true); wait();
+        stream_inputs(x_b, 0);      // prefetch into the other bank while A computes
+        for (int o = 0; o < 3; o++) check_row("pingpong A", o, ref_layer_row(w_a, x_a, o, mc_a));
+
+        write_manager(0, mc_b); write_pe_config(pc_b);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < 2; o++) check_row("pingpong B", o, ref_layer_row(w_b, x_b, o, mc_b));
+
+        for (int i = 0; i < N_IN; i++) axi_write(0x6, i, pack_vec(x_c[i]));
+        pe_start.Push(true); wait();
+        for (int o = 0; o < 2; o++) check_row("pingpong C", o, ref_layer_row(w_b, x_c, o, mc_b));
+    }
+
+    // Weight-stationary batch of two tokens: token b sits at b*num_input, each
+    // output row comes out once per token. Oversized batches are rejected.
+    void test_batch() {
+        std::cout << "Directed: batch mode, B=2" << std::endl;
+        const int N_IN = 2, N_OUT = 2, B = 2;
+        RefMat w = rand_mat(N_OUT*16, N_IN*16, -8, 7);
+        std::vector<RefVec> x[B];
+        for (int b = 0; b < B; b++) {
+            for (int i = 0; i < N_IN; i++) x[b].push_back(rand_vec(-16, 15));
+        }
+        load_weights(w, 0);
+
+        ManagerCfg mc(N_IN);
+        PECfg pc(N_OUT);
+        pc.num_batch = B;
+        write_manager(0, mc); write_pe_config(pc);
+        for (int b = 0; b < B; b++) stream_inputs(x[b], 0, b*N_IN);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) {
+            for (int b = 0; b < B; b++) check_row("batch", o*B + b, ref_layer_row(w, x[b], o, mc));
+        }
+
+        // 4 tokens x 100 output rows overflow the 8 bit output vector address
+        PECfg pc_big(100);
+        pc_big.num_batch = 4;
+        write_pe_config(pc_big);
+        check("batch output overflow rejected", !pe_config_valid());
+        // 3 tokens x 100 input vectors overflow the input stream address
+        pc_big.num_output = 1; pc_big.num_batch = 3;
+        write_manager(0, ManagerCfg(100)); write_pe_config(pc_big);
+        check("batch input overflow rejected", !pe_config_valid());
+        pc_big.num_batch = 2;
+        write_pe_config(pc_big);
+        check("batch within limits accepted", pe_config_valid());
+    }
+
+    // k-means clustered weights: 4 bit indices into the manager LUT, a word packs
+    // two weight rows (row 2k in [63:0], row 2k+1 in [127:64])
+    void test_cluster() {
+        std::cout << "Directed: cluster weights" << std::endl;
+        const int N_IN = 2, N_OUT = 2, BASE = 0x40;
+        RefVec lut = rand_vec(-8, 7);
+        RefMat idx = rand_mat(N_OUT*16, N_IN*16, 0, 15), w(N_OUT*16, RefVec(N_IN*16));
+        for (int r = 0; r < N_OUT*16; r++) {
+            for (int c = 0; c < N_IN*16; c++) w[r][c] = lut[idx[r][c]];
+        }
+        for (int o = 0; o < N_OUT; o++) {
+            for (int i = 0; i < N_IN; i++) {
+                for (int k = 0; k < 8; k++) {
+                    NVUINTW(128) d = 0;
+                    for (int e = 0; e < 16; e++) {
+                        d.set_slc(4*e, (NVUINT4)idx[o*16 + 2*k][i*16 + e]);
+                        d.set_slc(64 + 4*e, (NVUINT4)idx[o*16 + 2*k + 1][i*16 + e]);
+                    }
+                    axi_write(0x5, (o*N_IN + i)*8 + k + BASE, d);
+                }
+            }
+        }
+        axi_write(0x4, 0x3, pack_vec(lut));
+
+        std::vector<RefVec> x;
+        for (int i = 0; i < N_IN; i++) x.push_back(rand_vec(-16, 15));
+        ManagerCfg mc(N_IN);
+        mc.base_weight = BASE;
+        PECfg pc(N_OUT);
+        pc.is_cluster = 1;
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) check_row("cluster", o, ref_layer_row(w, x, o, mc));
+    }
+
+    // Fused bias: one int8 Q4.4 bias vector per output row at base_bias + o,
+    // shifted onto the Q4.12 act word before the clamp (full range biases saturate)
+    void test_bias() {
+        std::cout << "Directed: bias add" << std::endl;
+        const int N_IN = 2, N_OUT = 3, BASE_BIAS = 5;
+        RefMat w = rand_mat(N_OUT*16, N_IN*16, -8, 7);
+        std::vector<RefVec> x, bias;
+        for (int i = 0; i < N_IN; i++) x.push_back(rand_vec(-16, 15));
+        for (int o = 0; o < N_OUT; o++) {
+            bias.push_back(rand_vec(-128, 127));
+            axi_write(0x7, BASE_BIAS + o, pack_vec(bias[o]));
+        }
+        load_weights(w, 0);
+
+        ManagerCfg mc(N_IN);
+        mc.base_bias = BASE_BIAS;
+        PECfg pc(N_OUT);
+        pc.is_bias = 1;
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) {
+            check_row("bias", o, ref_requant(ref_gemv(w, x, o), RefVec(16, mc.accum_scale), mc.accum_shift, &bias[o]));
+        }
+    }
+
+    // Runtime requantization: a per layer multiplier/shift from the manager
+    // register, then per output channel multipliers from the scale SRAM
+    void test_requant() {
+        std::cout << "Directed: requantization" << std::endl;
+        const int N_IN = 2, N_OUT = 2, BASE_SCALE = 9;
+        RefMat w = rand_mat(N_OUT*16, N_IN*16, -64, 63);
+        std::vector<RefVec> x, scale;
+        for (int i = 0; i < N_IN; i++) x.push_back(rand_vec(-64, 63));
+        for (int o = 0; o < N_OUT; o++) {
+            scale.push_back(rand_vec(0, 255));
+            axi_write(0xA, BASE_SCALE + o, pack_vec(scale[o]));
+        }
+        load_weights(w, 0);
+
+        ManagerCfg mc(N_IN);
+        mc.accum_scale = 200; mc.accum_shift = 13;
+        PECfg pc(N_OUT);
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) check_row("requant layer", o, ref_layer_row(w, x, o, mc));
+
+        mc.is_channel_scale = 1; mc.base_scale = BASE_SCALE; mc.accum_shift = 12;
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) {
+            check_row("requant channel", o, ref_requant(ref_gemv(w, x, o), scale[o], mc.accum_shift, NULL));
+        }
+    }
+
+    // Zero skipping: a leading zero, a run longer than the look-ahead window and
+    // a trailing zero. Outputs must match and the skip counter (0x4 local 0x5)
+    // must count every skipped MAC cycle.
+    void test_zero_skip() {
+        std::cout << "Directed: zero skipping" << std::endl;
+        const int N_IN = 10, N_OUT = 2;
+        const bool zero_pattern[N_IN] = {1, 0, 1, 1, 1, 1, 1, 1, 0, 1};
+        RefMat w = rand_mat(N_OUT*16, N_IN*16, -8, 7);
+        std::vector<RefVec> x;
+        std::vector<bool> is_zero;
+        for (int i = 0; i < N_IN; i++) {
+            x.push_back(zero_pattern[i] ? RefVec(16, 0) : rand_vec(-16, 15));
+            is_zero.push_back(zero_pattern[i]);
+        }
+        load_weights(w, 0);
+
+        ManagerCfg mc(N_IN);
+        PECfg pc(N_OUT);
+        pc.is_zero_skip = 1;
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) check_row("zero skip", o, ref_layer_row(w, x, o, mc));
+        wait(10);
+        int skipped = nvhls::get_slc<32>(axi_read(0x4, 0x5), 0).to_int();
+        check("zero skip count", skipped == N_OUT * ref_zero_skips(is_zero));
+    }
+
+    // Drain pipeline under back pressure: two managers with their own bias and
+    // channel scales, act_port is not popped until every row has been computed,
+    // so rows queue behind the held drain register and must come out in order
+    void test_drain_stall() {
+        std::cout << "Directed: output drain under back pressure" << std::endl;
+        const int N_IN = 1, N_OUT = 4, M = 2;
+        RefMat w[M];
+        std::vector<RefVec> x[M], bias[M], scale[M];
+        ManagerCfg mc[M];
+        for (int m = 0; m < M; m++) {
+            w[m] = rand_mat(N_OUT*16, N_IN*16, -32, 31);
+            x[m].push_back(rand_vec(-32, 31));
+            load_weights(w[m], m*0x200);
+            mc[m] = ManagerCfg(N_IN);
+            mc[m].base_weight = m*0x200; mc[m].base_input = m*16;
+            mc[m].base_bias = m*N_OUT; mc[m].base_scale = m*N_OUT;
+            mc[m].is_channel_scale = 1; mc[m].accum_shift = 12;
+            for (int o = 0; o < N_OUT; o++) {
+                bias[m].push_back(rand_vec(-64, 63));
+                scale[m].push_back(rand_vec(0, 255));
+                axi_write(0x7, m*N_OUT + o, pack_vec(bias[m][o]));
+                axi_write(0xA, m*N_OUT + o, pack_vec(scale[m][o]));
+            }
+            write_manager(m, mc[m]);
+        }
+        PECfg pc(N_OUT);
+        pc.num_manager = M; pc.is_bias = 1;
+        write_pe_config(pc);
+        for (int m = 0; m < M; m++) stream_inputs(x[m], m);
+        pe_start.Push(true); wait();
+        wait(100);
+        for (int o = 0; o < N_OUT; o++) {
+            for (int m = 0; m < M; m++) {
+                check_row("drain stall", o*M + m,
+                          ref_requant(ref_gemv(w[m], x[m], o), scale[m][o], mc[m].accum_shift, &bias[m][o]));
+            }
+        }
+    }
+
+    // Weight partitions: layer B is loaded into partition 1 (region 0xB) in the
+    // background while layer A computes from partition 0. A layer running past
+    // the end of its partition is rejected.
+    void test_partition() {
+        std::cout << "Directed: weight partitions" << std::endl;
+        const int N_IN = 4, N_OUT = 4;
+        RefMat w_a = rand_mat(N_OUT*16, N_IN*16, -8, 7), w_b = rand_mat(N_OUT*16, N_IN*16, -8, 7);
+        std::vector<RefVec> x;
+        for (int i = 0; i < N_IN; i++) x.push_back(rand_vec(-16, 15));
+        load_weights(w_a, 0x300);
+
+        ManagerCfg mc_a(N_IN), mc_b(N_IN);
+        mc_a.base_weight = 0x300;
+        mc_b.base_weight = 0x300; mc_b.partition = 1;
+        PECfg pc(N_OUT);
+        write_manager(0, mc_a); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        load_weights(w_b, 0x300, 1);
+        for (int o = 0; o < N_OUT; o++) check_row("partition 0", o, ref_layer_row(w_a, x, o, mc_a));
+
+        write_manager(0, mc_b); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) check_row("partition 1", o, ref_layer_row(w_b, x, o, mc_b));
+
+        // two blocks from 0xFFE0 end exactly at the top of the partition, from 0xFFF0 they do not
+        ManagerCfg mc_top(2);
+        mc_top.base_weight = 0xFFE0; mc_top.partition = 1;
+        write_manager(0, mc_top); write_pe_config(PECfg(1));
+        check("partition top accepted", pe_config_valid());
+        mc_top.base_weight = 0xFFF0;
+        write_manager(0, mc_top); write_pe_config(PECfg(1));
+        check("partition overflow rejected", !pe_config_valid());
+    }
+
+    // K-tiling: a 6 block reduction run as 3 tiles of 2 blocks on two managers.
+    // Tile 0 stores, tile 1 loads and stores, tile 2 loads and drains. Each tile
+    // selects its weight columns through base_weight and stride_out. PEConfig is
+    // rewritten between tiles once the previous one has finished. Oversized
+    // and batched K-tiled configs are rejected.
+    void test_accum_tiles() {
+        std::cout << "Directed: K-tiled accumulation, 3 tiles" << std::endl;
+        const int N_TILE = 3, N_IN = 2, K = N_TILE*N_IN, N_OUT = 3, M = 2;
+        RefMat w[M];
+        std::vector<RefVec> x[M];
+        for (int m = 0; m < M; m++) {
+            w[m] = rand_mat(N_OUT*16, K*16, -32, 31);
+            for (int i = 0; i < K; i++) x[m].push_back(rand_vec(-32, 31));
+            load_weights(w[m], m*0x400);
+        }
+
+        ManagerCfg mc[M];
+        for (int t = 0; t < N_TILE; t++) {
+            for (int m = 0; m < M; m++) {
+                mc[m] = ManagerCfg(N_IN);
+                mc[m].base_weight = m*0x400 + t*N_IN*16;
+                mc[m].stride_out = K; mc[m].base_input = m*16;
+                write_manager(m, mc[m]);
+            }
+            PECfg pc(N_OUT);
+            pc.num_manager = M;
+            pc.is_accum_load = (t > 0); pc.is_accum_store = (t < N_TILE - 1);
+            write_pe_config(pc);
+            for (int m = 0; m < M; m++) {
+                std::vector<RefVec> x_tile(x[m].begin() + t*N_IN, x[m].begin() + (t+1)*N_IN);
+                stream_inputs(x_tile, m);
+            }
+            pe_start.Push(true); wait();
+            if (t < N_TILE - 1) wait(100);   // spill only, nothing on act_port
+        }
+        for (int o = 0; o < N_OUT; o++) {
+            for (int m = 0; m < M; m++) check_row("accum tiles", o*M + m, ref_layer_row(w[m], x[m], o, mc[m]));
+        }
+
+        // 4 managers x 65 rows need 260 psum entries
+        PECfg pc_big(65);
+        pc_big.num_manager = 4; pc_big.is_accum_store = 1;
+        write_manager(0, ManagerCfg(1)); write_manager(1, ManagerCfg(1));
+        write_pe_config(pc_big);
+        check("psum overflow rejected", !pe_config_valid());
+        pc_big.num_output = 64;
+        write_pe_config(pc_big);
+        check("psum full accepted", pe_config_valid());
+        pc_big.num_output = 65; pc_big.is_accum_store = 0;
+        write_pe_config(pc_big);
+        check("no tiling, no psum limit", pe_config_valid());
+
+        // psum holds one partial sum per row, not per token: no K-tiling in batch mode
+        PECfg pc_batch(1);
+        pc_batch.num_batch = 2; pc_batch.is_accum_store = 1;
+        write_manager(0, ManagerCfg(1)); write_pe_config(pc_batch);
+        check("batch accum store rejected", !pe_config_valid());
+        pc_batch.is_accum_store = 0; pc_batch.is_accum_load = 1;
+        write_pe_config(pc_batch);
+        check("batch accum load rejected", !pe_config_valid());
+        pc_batch.num_batch = 1;
+        write_pe_config(pc_batch);
+        check("accum load without batch accepted", pe_config_valid());
+    }
+
+    // num_manager is clamped to 1..kNumPEManagers on write and reads back clamped
+    void test_num_manager() {
+        std::cout << "Directed: num_manager clamp" << std::endl;
+        const int num_write[3] = {0, 9, 4};
+        const int num_read[3]  = {1, (int)spec::PE::kNumPEManagers, 4};
+        for (int m = 0; m < (int)spec::PE::kNumPEManagers; m++) write_manager(m, ManagerCfg(1));
+        for (int k = 0; k < 3; k++) {
+            PECfg pc(1);
+            pc.num_manager = num_write[k];
+            write_pe_config(pc);
+            int num = nvhls::get_slc<4>(axi_read(0x4, 0x1), 32).to_int();
+            check("num_manager readback", num == num_read[k]);
+        }
+        // num_manager = 0 runs one manager
+        RefMat w = rand_mat(16, 16, -8, 7);
+        std::vector<RefVec> x(1, rand_vec(-16, 15));
+        load_weights(w, 0);
+        ManagerCfg mc(1);
+        PECfg pc(1);
+        pc.num_manager = 0;
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        check_row("num_manager 0", 0, ref_layer_row(w, x, 0, mc));
+    }
+
+    // Transposed weight walk: A is stored row major as usual (R x C blocks) and
+    // A^T x is run from the same layout with stride_out = 1, stride_in = C.
+    // int4 words cannot be transposed, that config is rejected.
+    void test_transpose() {
+        std::cout << "Directed: transposed weights" << std::endl;
+        const int R = 3, C = 2, BASE = 0x600;
+        RefMat a = rand_mat(R*16, C*16, -32, 31), a_t(C*16, RefVec(R*16));
+        for (int r = 0; r < R*16; r++) {
+            for (int c = 0; c < C*16; c++) a_t[c][r] = a[r][c];
+        }
+        load_weights(a, BASE);
+        std::vector<RefVec> x;
+        for (int i = 0; i < R; i++) x.push_back(rand_vec(-32, 31));
+
+        ManagerCfg mc(R);
+        mc.base_weight = BASE; mc.is_transpose = 1;
+        mc.stride_out = 1; mc.stride_in = C;
+        PECfg pc(C);
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < C; o++) check_row("transpose", o, ref_layer_row(a_t, x, o, mc));
+
+        pc.is_int4 = 1;
+        write_pe_config(pc);
+        check("int4 transpose rejected", !pe_config_valid());
+        mc.is_transpose = 0;
+        write_manager(0, mc); write_pe_config(pc);
+        check("int4 without transpose accepted", pe_config_valid());
+    }
+
+    // int4 mode: weight and input words pack 32 int4 values, num_input counts
+    // 32 element words, weight block (o, i) holds the 32 columns of word i for
+    // the 16 rows of o. int4 cluster weights are rejected.
+    void test_int4() {
+        std::cout << "Directed: int4 weights and inputs" << std::endl;
+        const int N_IN = 2, N_OUT = 2, BASE = 0x700;
+        RefMat w = rand_mat(N_OUT*16, N_IN*32, -8, 7);
+        for (int o = 0; o < N_OUT; o++) {
+            for (int i = 0; i < N_IN; i++) {
+                for (int k = 0; k < 16; k++) {
+                    RefVec row(w[o*16 + k].begin() + i*32, w[o*16 + k].begin() + i*32 + 32);
+                    axi_write(0x5, (o*N_IN + i)*16 + k + BASE, pack_vec(pack_int4(row)));
+                }
+            }
+        }
+        // x16 holds the logical inputs 16 at a time for ref_gemv, x the packed words
+        std::vector<RefVec> x16, x;
+        for (int i = 0; i < 2*N_IN; i++) x16.push_back(rand_vec(-8, 7));
+        for (int i = 0; i < N_IN; i++) {
+            RefVec word(x16[2*i]);
+            word.insert(word.end(), x16[2*i + 1].begin(), x16[2*i + 1].end());
+            x.push_back(pack_int4(word));
+        }
+
+        ManagerCfg mc(N_IN);
+        mc.base_weight = BASE;
+        PECfg pc(N_OUT);
+        pc.is_int4 = 1;
+        write_manager(0, mc); write_pe_config(pc);
+        stream_inputs(x, 0);
+        pe_start.Push(true); wait();
+        for (int o = 0; o < N_OUT; o++) check_row("int4", o, ref_layer_row(w, x16, o, mc));
+
+        pc.is_cluster = 1;
+        write_pe_config(pc);
+        check("int4 cluster rejected", !pe_config_valid());
+    }
+
+    void run() {
+        pe_start.Reset(); pe_in.Reset(); pe_rva_in.Reset(); pe_rva_out.Reset(); pe_out.Reset();
+        srand(1);
+        wait(20);
+
+        test_pingpong();
+        test_batch();
+        test_cluster();
+        test_bias();
+        test_requant();
+        test_zero_skip();
+        test_drain_stall();
+        test_partition();
+        test_accum_tiles();
+        test_num_manager();
+        test_transpose();
+        test_int4();
+
+        std::cout << "Directed PECore cases: " << directed_errors << " errors" << std::endl;
+        directed_done = true;
+        while (1) wait();
+    }
+};
+
 SC_MODULE(Source) {
     sc_in<bool> clk;
     sc_in<bool> rst;
@@ -57,6 +715,7 @@ SC_MODULE(Source) {
         pe_start.Reset(); pe_in.Reset(); pe_rva_in.Reset(); act_out.Reset();
 
         wait(20);
+        while (!directed_done) wait();
 
         const int TOKENS = 208;
         const int VECS_IN = 24;  // 384 input channels
@@ -185,6 +844,7 @@ SC_MODULE(Sink) {
 
         if (errors == 0) std::cout << "\nSUCCESS: Full 208x1536 Matrix Verified! 0 Mismatches." << std::endl;
         else std::cout << "\nFAILED with " << errors << " mismatches." << std::endl;
+        if (directed_errors != 0) std::cout << "FAILED with " << directed_errors << " directed PECore mismatches." << std::endl;
         sc_stop();
     }
 };
@@ -208,12 +868,22 @@ SC_MODULE(Testbench) {
     Connections::Combinational<spec::StreamType> router_ch;
     sc_signal<NVUINT32> sram_config;
 
+    Connections::Combinational<bool> d_st;
+    Connections::Combinational<spec::StreamType> d_in;
+    Connections::Combinational<spec::Axi::SubordinateToRVA::Write> d_rva;
+    Connections::Combinational<spec::Axi::SubordinateToRVA::Read> d_rva_out;
+    Connections::Combinational<spec::ActVectorType> d_out;
+    sc_signal<NVUINT32> d_sram_config;
+
     ActUnit act_inst;
     PECore pe_inst;
     Source src;
     Sink snk;
+    PECore pe_dir;
+    DirectedPE dir;
 
-    SC_CTOR(Testbench) : clk("clk", 1, SC_NS), act_inst("act_inst"), pe_inst("pe_inst"), src("src"), snk("snk") {
+    SC_CTOR(Testbench) : clk("clk", 1, SC_NS), act_inst("act_inst"), pe_inst("pe_inst"), src("src"), snk("snk"),
+                         pe_dir("pe_dir"), dir("dir") {
         act_inst.clk(clk); act_inst.rst(rst); act_inst.start(act_start_ch); act_inst.act_port(act_port_in_ch); 
         act_inst.rva_in(act_rva_in_ch); act_inst.rva_out(act_rva_out_ch); act_inst.output_port(router_ch); act_inst.done(act_done_ch);
 
@@ -225,6 +895,12 @@ SC_MODULE(Testbench) {
 
         snk.clk(clk); snk.rst(rst); snk.pe_out(pe_out_port_ch); snk.pe_rva_out(pe_rva_out_ch); snk.act_rva_out(act_rva_out_ch); snk.act_done(act_done_ch);
 
+        pe_dir.clk(clk); pe_dir.rst(rst); pe_dir.start(d_st); pe_dir.input_port(d_in); pe_dir.rva_in(d_rva);
+        pe_dir.act_port(d_out); pe_dir.rva_out(d_rva_out); pe_dir.SC_SRAM_CONFIG(d_sram_config);
+
+        dir.clk(clk); dir.rst(rst); dir.pe_start(d_st); dir.pe_in(d_in); dir.pe_rva_in(d_rva);
+        dir.pe_rva_out(d_rva_out); dir.pe_out(d_out);
+
         SC_THREAD(reset_driver);
     }
     void reset_driver() { rst.write(false); wait(5, SC_NS); rst.write(true); wait(5, SC_NS); }
@@ -112,10 +112,15 @@ class PERVA : public match::Module {
           case 0x4:
           case 0x5:
           case 0x6:
+          case 0x7:
+          case 0xA:
+          case 0xB:
             pe_rva_in.Push(rva_in_reg);
             break;
           case 0x8:
           case 0x9:
+          case 0xC:
+          case 0xD:
             act_rva_in.Push(rva_in_reg);
             break;
           case 0xE:
@@ -191,7 +196,11 @@ class PEModule : public match::Module {
   Connections::Combinational<bool> act_start;    
   Connections::Combinational<spec::Axi::SubordinateToRVA::Write> act_rva_in;
   Connections::Combinational<spec::Axi::SubordinateToRVA::Read> act_rva_out;
-  Connections::Combinational<spec::ActVectorType> act_port;
+  // PECore -> act_port FIFO -> ActUnit, so a full output tile can drain
+  // from PECore while the ActUnit program is still busy
+  Connections::Combinational<spec::ActVectorType> act_port_enq;
+  Connections::Combinational<spec::ActVectorType> act_port_deq;
+  Connections::Buffer<spec::ActVectorType, spec::Act::kActPortDepth> act_port;
 
   sc_signal<NVUINT32> SC_SRAM_CONFIG;
 
@@ -214,6 +223,8 @@ class PEModule : public match::Module {
         act_start("act_start"),
         act_rva_in("act_rva_in"),
         act_rva_out("act_rva_out"),
+        act_port_enq("act_port_enq"),
+        act_port_deq("act_port_deq"),
         act_port("act_port"),
         SC_SRAM_CONFIG("SC_SRAM_CONFIG"),
         perva_inst("perva_inst"),
@@ -233,9 +244,14 @@ class PEModule : public match::Module {
     perva_inst.act_rva_out(act_rva_out);
     perva_inst.SC_SRAM_CONFIG(SC_SRAM_CONFIG);
     
+    act_port.clk(clk);
+    act_port.rst(rst);
+    act_port.enq(act_port_enq);
+    act_port.deq(act_port_deq);
+
     pecore_inst.clk(clk);
     pecore_inst.rst(rst);
-    pecore_inst.act_port(act_port);
+    pecore_inst.act_port(act_port_enq);
     pecore_inst.input_port(input_port);
     pecore_inst.start(pe_start);
     pecore_inst.rva_in(pe_rva_in);
@@ -245,7 +261,7 @@ class PEModule : public match::Module {
 
     act_inst.clk(clk);
     act_inst.rst(rst);    
-    act_inst.act_port(act_port);
+    act_inst.act_port(act_port_deq);
     act_inst.start(act_start);
     act_inst.rva_in(act_rva_in);
     act_inst.rva_out(act_rva_out);
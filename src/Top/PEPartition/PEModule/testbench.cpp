@@ -6,9 +6,11 @@
 #include <vector>
 #include <iomanip>
 #include <cmath>
+#include <cstdlib>
 
 #include "PECore/PECore.h"
 #include "ActUnit/ActUnit.h"
+#include "PEModule.h"
 
 const int TOKENS = 208;
 const int VECS_384 = 24;
@@ -35,6 +37,145 @@ spec::ActVectorType promote(spec::StreamType in) {
     return out;
 }
 
+// =============================================================================
+// Directed PEModule case: PECore -> act_port FIFO -> ActUnit wiring, run
+// before the ResMLP layer (the PECore-only cases live in PECore/testbench.cpp)
+// =============================================================================
+
+typedef std::vector<int> RefVec;               // 16 lanes
+
+int  directed_errors = 0;
+bool module_done     = false;
+
+RefVec rand_vec(int lo, int hi) {
+    RefVec v(16);
+    for (int j = 0; j < 16; j++) v[j] = lo + rand() % (hi - lo + 1);
+    return v;
+}
+
+// Lane j of an int8 vector in [8j+7:8j]
+NVUINTW(128) pack_vec(const RefVec& v) {
+    NVUINTW(128) d = 0;
+    for (int j = 0; j < 16; j++) d.set_slc(8*j, (NVUINT8)(v[j] & 0xFF));
+    return d;
+}
+
+// PECore output row o of a single input vector: default layer scale and
+// shift, clamped to the act word
+RefVec ref_layer_row(const std::vector<RefVec>& w, const RefVec& x, int o) {
+    RefVec out(16);
+    for (int c = 0; c < 16; c++) {
+        long long acc = 0;
+        for (int k = 0; k < 16; k++) acc += (long long)w[o*16 + c][k] * x[k];
+        long long v = (acc * spec::kAccumScale) >> spec::kAccumShift;
+        if (v > spec::kActWordMax) v = spec::kActWordMax;
+        if (v < spec::kActWordMin) v = spec::kActWordMin;
+        out[c] = (int)v;
+    }
+    return out;
+}
+
+// OUTGB of a Q4.12 act word with the default Q4.4 output format
+int ref_act_out(int q412) {
+    int q = (q412 + 128) >> 8;
+    if (q > 127)  q = 127;
+    if (q < -128) q = -128;
+    return q;
+}
+
+SC_MODULE(DirectedModule) {
+    sc_in<bool> clk, rst;
+
+    Connections::Out<bool> start;
+    Connections::Out<spec::Axi::SubordinateToRVA::Write> rva_in;
+    Connections::In<spec::Axi::SubordinateToRVA::Read> rva_out;
+    Connections::Out<spec::StreamType> input_port;
+    Connections::In<spec::StreamType> output_port;
+    Connections::In<bool> done;
+
+    SC_CTOR(DirectedModule) { SC_THREAD(run); sensitive << clk.pos(); async_reset_signal_is(rst, false); }
+
+    void axi_write(int region, int local_index, const NVUINTW(128)& data) {
+        spec::Axi::SubordinateToRVA::Write cmd; cmd.rw = 1;
+        cmd.addr = ((NVUINTW(24))region << 20) | ((NVUINTW(24))local_index << 4);
+        cmd.data = data; rva_in.Push(cmd); wait();
+    }
+
+    void check(const char* name, bool ok) {
+        if (!ok) { directed_errors++; std::cout << "  " << name << " FAILED" << std::endl; }
+    }
+
+    // A full kActPortDepth tile from PECore while the ActUnit program is held
+    // by an output_port that is not popped: the tile must drain into the
+    // act_port FIFO and PECore must return to IDLE (and pop the next input)
+    // before a single ActUnit output has been taken
+    void test_act_port_stall() {
+        std::cout << "Directed: PEModule act_port FIFO under a stalled ActUnit" << std::endl;
+        const int N_OUT = spec::Act::kActPortDepth;
+        std::vector<RefVec> w;
+        for (int r = 0; r < N_OUT*16; r++) w.push_back(rand_vec(-32, 31));
+        RefVec x = rand_vec(-32, 31);
+
+        for (int r = 0; r < N_OUT*16; r++) axi_write(0x5, r, pack_vec(w[r]));
+        NVUINTW(128) m = 0; m.set_slc(8, (NVUINT8)1);
+        axi_write(0x4, 0x2, m);
+        NVUINTW(128) r = 0;
+        r.set_slc(0, (NVUINT8)spec::kAccumScale); r.set_slc(8, (NVUINT5)spec::kAccumShift);
+        axi_write(0x4, 0x4, r);
+        NVUINTW(128) p = 0;
+        p.set_slc(0, (NVUINT1)1); p.set_slc(32, (NVUINT4)1); p.set_slc(40, (NVUINT8)N_OUT);
+        axi_write(0x4, 0x1, p);
+
+        // INPE R1; OUTGB R1 for every output
+        NVUINTW(128) inst = 0;
+        inst.set_slc(0, (NVUINT8)0x34); inst.set_slc(8, (NVUINT8)0x44);
+        axi_write(0x8, 0x2, inst);
+        NVUINTW(128) cfg = 0;
+        cfg.set_slc(0, (NVUINT1)1); cfg.set_slc(24, (NVUINT6)2); cfg.set_slc(32, (NVUINT8)N_OUT);
+        axi_write(0x8, 0x1, cfg);
+        wait(2);
+
+        spec::StreamType st;
+        for (int j = 0; j < 16; j++) st.data[j] = x[j];
+        input_port.Push(st); wait();
+        start.Push(true); wait();
+        wait(20);
+
+        // Without ping-pong PECore only pops input_port in IDLE; the second
+        // probe can only be taken once PECore has popped the first one
+        int num_probe = 0;
+        for (int t = 0; t < 4000 && num_probe < 2; t++) {
+            if (input_port.PushNB(st)) num_probe++;
+            wait();
+        }
+        check("PECore drains a full tile into act_port", num_probe == 2);
+
+        for (int o = 0; o < N_OUT; o++) {
+            spec::StreamType out = output_port.Pop();
+            RefVec ref = ref_layer_row(w, x, o);
+            bool ok = (out.logical_addr == o);
+            for (int c = 0; c < 16; c++) ok &= ((int)out.data[c].to_int() == ref_act_out(ref[c]));
+            if (!ok) {
+                directed_errors++;
+                std::cout << "  act_port stall output " << o << " mismatch" << std::endl;
+            }
+        }
+        done.Pop();
+    }
+
+    void run() {
+        start.Reset(); rva_in.Reset(); rva_out.Reset(); input_port.Reset(); output_port.Reset(); done.Reset();
+        srand(1);
+        wait(20);
+
+        test_act_port_stall();
+
+        std::cout << "Directed PEModule cases: " << directed_errors << " errors" << std::endl;
+        module_done = true;
+        while (1) wait();
+    }
+};
+
 SC_MODULE(Orchestrator) {
     sc_in<bool> clk, rst;
 
@@ -51,15 +192,29 @@ SC_MODULE(Orchestrator) {
 
     SC_CTOR(Orchestrator) { SC_THREAD(run); sensitive << clk.pos(); async_reset_signal_is(rst, false); }
 
-    void act_config(NVUINT8 count, NVUINT8* mcode, int loops) {
+    void act_config(NVUINT8 count, NVUINT8* mcode, int loops, int param_base = 0, int param_stride = 0) {
         NVUINTW(128) idata = 0; for (int i=0; i<count; i++) idata.set_slc(8*i, mcode[i]);
         spec::Axi::SubordinateToRVA::Write cmd; cmd.rw = 1;
         cmd.addr = 0x800020; cmd.data = idata; act_rva_in.Push(cmd); wait();
         
         NVUINTW(128) cdata = 0; cdata.set_slc(0, (NVUINT1)1); cdata.set_slc(24, (NVUINT6)count); cdata.set_slc(32, (NVUINT8)loops);
+        cdata.set_slc(80, (NVUINT7)param_base); cdata.set_slc(88, (NVUINT4)param_stride);
         cmd.addr = 0x800010; cmd.data = cdata; act_rva_in.Push(cmd); wait();
     }
 
+    // Writes arr[v] to parameter vector base + v*stride, one 8-lane half per AXI write
+    void act_params(const std::vector<int16_t>& arr, int vecs, int base, int stride) {
+        for(int v=0; v<vecs; v++) {
+            for(int h=0; h<2; h++) {
+                NVUINTW(128) pdata = 0;
+                for(int j=0; j<8; j++) pdata.set_slc(16*j, (NVUINT16)arr[v*16 + h*8 + j]);
+                spec::Axi::SubordinateToRVA::Write cmd; cmd.rw = 1;
+                cmd.addr = 0xC00000 | (((base + v*stride)*2 + h) << 4); cmd.data = pdata; act_rva_in.Push(cmd);
+            }
+        }
+        wait();
+    }
+
     void pe_config(int in_ch, int out_ch, int base) {
         NVUINTW(128) mcfg = 0; mcfg.set_slc(8, (NVUINT8)in_ch); mcfg.set_slc(16, (NVUINT16)base);
         spec::Axi::SubordinateToRVA::Write cmd; cmd.rw = 1; cmd.addr = 0x400020; cmd.data = mcfg; pe_rva_in.Push(cmd); wait(2);
@@ -87,6 +242,7 @@ SC_MODULE(Orchestrator) {
         act_start.Reset(); act_port.Reset(); act_rva_in.Reset(); act_out.Reset(); act_done.Reset();
         pe_start.Reset(); pe_in.Reset(); pe_rva_in.Reset(); pe_out.Reset();
         wait(20);
+        while (!module_done) wait();
 
         std::vector<int16_t> x, tok_out, ls1, n2a, n2b, fc1_b, fc2_b, ls2;
         std::vector<int8_t> fc1_w, fc2_w, gold;
@@ -104,9 +260,15 @@ SC_MODULE(Orchestrator) {
         load_bin<int8_t>("../../../../software/tb_data/w_fc2_w.bin", fc2_w, VECS_384*16*VECS_1536*16);
         load_bin<int8_t>("../../../../software/tb_data/g6_final.bin", gold, TOKENS*VECS_384*16);
 
-        NVUINT8 mc_base[] = {0x34, 0x38, 0x99, 0x34, 0x89, 0x48}; 
+        // LDPM (0x64/0x6C) pulls per-channel constants from the resident param bank,
+        // EFMA (0x59) R2 = R2*R1 + R3 fuses each scale and add
+        NVUINT8 mc_ls1[]  = {0x64, 0x38, 0x3C, 0x59, 0x48};
+        NVUINT8 mc_norm[] = {0x64, 0x6C, 0x38, 0x59, 0x48};
         NVUINT8 mc_gelu[] = {0x34, 0x38, 0x89, 0xF8, 0x48};       
-        NVUINT8 mc_res[]  = {0x38, 0x34, 0x89, 0x34, 0x99, 0x34, 0x89, 0x48}; 
+        NVUINT8 mc_res[]  = {0x38, 0x64, 0x89, 0x64, 0x3C, 0x59, 0x48};
+
+        // Param bank layout: ls1 @0, (n2a, n2b) interleaved @24, (fc2_b, ls2) interleaved @72
+        const int P_LS1 = 0, P_NORM = VECS_384, P_RES = 3 * VECS_384;
 
         // Buffers to hold intermediate layer data
         std::vector<spec::StreamType> ch_hid_buf(TOKENS * VECS_1536);
@@ -116,22 +278,27 @@ SC_MODULE(Orchestrator) {
 
         std::cout << "\n=== HARDWARE INIT (PART 1) ===" << std::endl;
         load_w(fc1_w, VECS_384, VECS_1536, 0); // Load FC1 at Address 0
+        act_params(ls1,   VECS_384, P_LS1,      1);
+        act_params(n2a,   VECS_384, P_NORM,     2);
+        act_params(n2b,   VECS_384, P_NORM + 1, 2);
+        act_params(fc2_b, VECS_384, P_RES,      2);
+        act_params(ls2,   VECS_384, P_RES + 1,  2);
 
         std::cout << "\n=== PHASE 1-4: Processing All Tokens ===" << std::endl;
         for (int t = 0; t < TOKENS; t++) {
             // Phase 1: LS1 + Res
-            act_config(6, mc_base, VECS_384); act_start.Push(true); wait();
+            act_config(5, mc_ls1, VECS_384, P_LS1, 1); act_start.Push(true); wait();
             for(int v=0; v<VECS_384; v++) {
-                act_port.Push(get_vec(ls1, v)); act_port.Push(get_vec(tok_out, t*VECS_384 + v)); act_port.Push(get_vec(x, t*VECS_384 + v));
+                act_port.Push(get_vec(tok_out, t*VECS_384 + v)); act_port.Push(get_vec(x, t*VECS_384 + v));
                 spec::StreamType res = act_out.Pop();
                 x_tok_promoted_buf[t*VECS_384 + v] = promote(res); // Save for Phase 6
             }
             act_done.Pop();
 
             // Phase 2: Norm 2
-            act_config(6, mc_base, VECS_384); act_start.Push(true); wait();
+            act_config(5, mc_norm, VECS_384, P_NORM, 2); act_start.Push(true); wait();
             for(int v=0; v<VECS_384; v++) {
-                act_port.Push(get_vec(n2a, v)); act_port.Push(x_tok_promoted_buf[t*VECS_384 + v]); act_port.Push(get_vec(n2b, v));
+                act_port.Push(x_tok_promoted_buf[t*VECS_384 + v]);
                 x_scl[v] = act_out.Pop();
             }
             act_done.Pop();
@@ -165,10 +332,9 @@ SC_MODULE(Orchestrator) {
             for(int v=0; v<VECS_384; v++) raw2[v] = pe_out.Pop();
 
             // Phase 6: FC2 Bias + LS2 + Residual
-            act_config(8, mc_res, VECS_384); act_start.Push(true); wait();
+            act_config(7, mc_res, VECS_384, P_RES, 2); act_start.Push(true); wait();
             for(int v=0; v<VECS_384; v++) {
-                act_port.Push(raw2[v]); act_port.Push(get_vec(fc2_b, v)); 
-                act_port.Push(get_vec(ls2, v)); act_port.Push(x_tok_promoted_buf[t*VECS_384 + v]);
+                act_port.Push(raw2[v]); act_port.Push(x_tok_promoted_buf[t*VECS_384 + v]);
                 spec::StreamType hw_final = act_out.Pop();
                 
                 // Verification
@@ -184,6 +350,7 @@ SC_MODULE(Orchestrator) {
 
         if (errors == 0) std::cout << "\nSUCCESS: Full 208-Token Layer Verified Matches PyTorch!" << std::endl;
         else std::cout << "\nFAILED with " << errors << " mismatches." << std::endl;
+        if (directed_errors != 0) std::cout << "FAILED with " << directed_errors << " directed PEModule mismatches." << std::endl;
         sc_stop();
     }
 };
@@ -220,9 +387,16 @@ SC_MODULE(Testbench) {
     Connections::Combinational<spec::Axi::SubordinateToRVA::Read> a_rva_out, p_rva_out;
     sc_signal<NVUINT32> sram_config;
 
+    Connections::Combinational<bool> m_st, m_done;
+    Connections::Combinational<spec::Axi::SubordinateToRVA::Write> m_rva;
+    Connections::Combinational<spec::Axi::SubordinateToRVA::Read> m_rva_out;
+    Connections::Combinational<spec::StreamType> m_in, m_out;
+
     ActUnit act; PECore pe; Orchestrator src; Sink snk;
+    PEModule pe_mod; DirectedModule dir_mod;
 
-    SC_CTOR(Testbench) : clk("clk", 1, SC_NS), act("act"), pe("pe"), src("src"), snk("snk") {
+    SC_CTOR(Testbench) : clk("clk", 1, SC_NS), act("act"), pe("pe"), src("src"), snk("snk"),
+                         pe_mod("pe_mod"), dir_mod("dir_mod") {
         act.clk(clk); act.rst(rst); act.start(a_st); act.act_port(a_pt); act.rva_in(a_rva); 
         act.output_port(a_out); act.rva_out(a_rva_out); act.done(a_done);
         
@@ -235,6 +409,12 @@ SC_MODULE(Testbench) {
 
         snk.clk(clk); snk.rst(rst); snk.pe_rva_out(p_rva_out); snk.act_rva_out(a_rva_out);
 
+        pe_mod.clk(clk); pe_mod.rst(rst); pe_mod.start(m_st); pe_mod.done(m_done); pe_mod.rva_in(m_rva);
+        pe_mod.rva_out(m_rva_out); pe_mod.input_port(m_in); pe_mod.output_port(m_out);
+
+        dir_mod.clk(clk); dir_mod.rst(rst); dir_mod.start(m_st); dir_mod.done(m_done); dir_mod.rva_in(m_rva);
+        dir_mod.rva_out(m_rva_out); dir_mod.input_port(m_in); dir_mod.output_port(m_out);
+
         SC_THREAD(reset_driver);
     }
     void reset_driver() { rst.write(false); wait(5, SC_NS); rst.write(true); wait(5, SC_NS); }
@@ -48,76 +48,419 @@ namespace spec {
     
 
     const unsigned int kNumInstEntries = 32;
+    const unsigned int kRegIndexWidth = nvhls::index_width<kNumActEntries>::val;
+    typedef NVUINTW(kRegIndexWidth) RegIndex;
+    const int kNumLoops = 2;  // hardware loop levels, 0 is the innermost
+
+    // Cross-lane reduction registers, Q20.20 holds a sum of squares of
+    // 16 lanes x 256 Q4.12 vectors without overflow
+    const int kNumReduceEntries = 4;
+    const int kReduceWidth = 40;
+    const int kReduceIntWidth = 20;
+    typedef ac_fixed<kReduceWidth, kReduceIntWidth, true> ReduceType;
+    const int kReduceScaleWidth = 16;   // HGET scale, unsigned 0.16, 0 means 1.0
+
+    // PECore -> ActUnit act_port FIFO, holds a full 16-vector output tile
+    // so the PECore drain never waits on the ActUnit epilogue
+    const int kActPortDepth = 16;
+
+    // Programmable piecewise-linear activation (region 0xD), all Q4.12
+    const int kNumLutSegments = 16;
+    typedef NVUINTW(nvhls::index_width<kNumInstEntries>::val) InstIndex;
+
+    // Resident per-channel parameters (norm alpha/beta, layer scale, ...)
+    // Each Q4.12 vector is split into two 8-lane halves, one per bank, so a
+    // 128-bit AXI write fills one half and LDPM reads both halves in one cycle
+    namespace Param {
+      const int kNumBanks = 2;
+      const int kNumReadPorts = 2;
+      const int kNumWritePorts = 1;
+      const int kNumLanes = kNumVectorLanes / kNumBanks;
+      const int kNumVectors = 128;
+      const int kEntriesPerBank = kNumVectors;
+      typedef nvhls::nv_scvector<ActScalarType, kNumLanes> WordType;
+      const unsigned int kAddressWidth = nvhls::index_width<kNumBanks * kEntriesPerBank>::val;
+      const unsigned int kVectorIndexWidth = nvhls::index_width<kNumVectors>::val;
+      typedef NVUINTW(kAddressWidth) Address;
+      typedef NVUINTW(kVectorIndexWidth) VectorIndex;
+    }
   }
 }
 
-inline spec::Act::kActOutputPortType ConvertToActOutput(spec::Act::kActOutputPortScalar in){
-  return in;
+// Per-layer int8 format: round(x * 2^out_frac) + zero_point, saturated.
+// out_frac = kActOutNumFrac with no zero point is the Q4.4 kActOutputPortType
+// conversion of a kActOutputPortScalar; out_frac is at most kActNumFrac
+inline spec::ScalarType ConvertToActOutput(const spec::ActScalarType in, const NVUINT4 out_frac, const spec::ScalarType zero_point){
+  const int kMax = (1 << (spec::kIntWordWidth - 1)) - 1;
+  const int kMin = -(1 << (spec::kIntWordWidth - 1));
+  NVUINT4 shift = 0;
+  if (out_frac < spec::kActNumFrac) {
+    shift = spec::kActNumFrac - out_frac;
+  }
+  NVINTW(spec::kActWordWidth + 2) rounded = in;
+  if (shift != 0) {
+    NVINTW(spec::kActWordWidth + 2) half = 1;
+    half = half << (shift - 1);
+    rounded = (rounded + half) >> shift;   // AC_RND
+  }
+  rounded += zero_point;
+  spec::ScalarType out;
+  if (rounded > kMax)      out = kMax;   // AC_SAT
+  else if (rounded < kMin) out = kMin;
+  else                     out = rounded;
+  return out;
 }
 
 /* New version Mini instruction (only tries to support a minimum number of operations)
  OP (4-bit) A2 (2-bit, dest) A1 (1-bit, src)
 
+ Wide instruction (is_wide = 1, 16-bit, written through config 0x04-0x07)
+ OP [15:11] DST [10:8] SRC1 [7:5] SRC2 [4:2] FLAGS [1:0]
+  same OP list, but non-destructive and over all 8 registers:
+  LOAD/INPE/LDPM write DST, STORE/OUTGB read SRC1,
+  unary ops DST = f(SRC1), binary ops DST = SRC1 op SRC2,
+  EFMA DST = SRC1*SRC2 + DST
+  FLAGS[0] saturates EADD/EMUL/EFMA/ALUT for this instruction, is_saturate for all
+  an 8-bit instruction decodes as DST = A2, SRC1 = A1 (COPY and binary ops)
+  or A2 (everything else), SRC2 = A2, and R3 as the EFMA addend
+
+  Wide-only sequencer ops, IMM = [7:3]
+  10: LOOP: repeat the next IMM+1 instructions loop_count[DST] times,
+            the back edge costs no cycle; level 0 must nest inside level 1,
+            a body running past num_inst is cut at the last instruction
+  11: JMP:  jump to instruction IMM if condition DST holds
+            0: always, 1: first output, 2: last output, 3: not last output
+            a taken JMP from the last instruction (or to IMM >= num_inst)
+            still ends the pass, the next output then starts at IMM;
+            a taken JMP out of a loop body, or from its last instruction,
+            ends that loop, and every loop ends with the pass
+  LOAD/STORE/OUTGB address output_counter*loop_count[0] + level 0 iteration
+  once a level 0 LOOP has run: each output owns loop_count[0] consecutive
+  vectors (num_output*loop_count[0] <= 256); without a level 0 LOOP, and for
+  8-bit programs, they address output_counter whatever loop_count holds
+
+  Wide-only cross-lane reductions into scalar register S[DST[1:0]]; S is
+  emptied by the start pulse (or restarted by FLAGS[1]) and otherwise
+  accumulates across output_counter and loop iterations
+  12: HSUM: S[DST] += sum(SRC1)
+  13: HSSQ: S[DST] += sum(SRC1*SRC1)
+  14: HMAX: S[DST] = max(S[DST], max(SRC1))
+  15: HGET: broadcast S[SRC1] to all lanes of DST, saturated to Q4.12,
+            multiplied by reduce_scale when FLAGS[1] is set (e.g. 1/N for a mean)
+  16: ALUT: DST = slope[k]*SRC1 + offset[k], k the last segment with
+            breakpoint[k] <= SRC1 (breakpoint[0] is ignored, acts as -inf)
+
   OP list
   0: NOP
   1: LOAD:  use output counter to locate (to A2)
   2: STORE: use output counter to locate (from A2)
   3: INPE:  wait data from PE and store  (to A2)
   4: OUTGB: Output to output port        (to A2)
-  
+  5: EFMA: A2*A1+R3 => A2 (R3 is the implicit addend, single rounding)
+  6: LDPM: load next parameter vector    (to A2)
+           param_addr_base + output_counter*param_stride + param_counter
+
   7: COPY: A1 -> A2
   8: EADD: A2+A1 => A2
   9: EMUL: A2*A1 => A2
-  A: SIGM: 
+  A: SIGM: sigmoid(A2) => A2
   B: TANH:
   C: RELU:
-  D: ONEX:
+  D: ONEX: 1-A2 => A2
   E: SILU:
   F: GELU:
 */
 
 
+// Piecewise-linear table for ALUT, 16 segments with ascending breakpoints
+// local_index 0x0/0x1 breakpoints, 0x2/0x3 slopes, 0x4/0x5 offsets,
+// 8 Q4.12 entries per write; reset to the identity function
+class ActLut {
+  static const int write_width = 128;
+  static const int kEntriesPerWrite = write_width / spec::kActWordWidth;
+
+ public:
+  spec::ActScalarType breakpoint[spec::Act::kNumLutSegments];
+  spec::ActScalarType slope[spec::Act::kNumLutSegments];
+  spec::ActScalarType offset[spec::Act::kNumLutSegments];
+
+  ActLut() {
+    Reset();
+  }
+
+  void Reset() {
+    #pragma hls_unroll yes
+    for (int i = 0; i < spec::Act::kNumLutSegments; i++) {
+      breakpoint[i] = 0;
+      slope[i]      = 1 << spec::kActNumFrac;
+      offset[i]     = 0;
+    }
+  }
+
+  void LutWrite(const NVUINT4 write_index, const NVUINTW(write_width)& write_data) {
+    NVUINT1 half = nvhls::get_slc<1>(write_index, 0);
+    NVUINT3 table = nvhls::get_slc<3>(write_index, 1);
+    #pragma hls_unroll yes
+    for (int i = 0; i < kEntriesPerWrite; i++) {
+      spec::ActScalarType data = nvhls::get_slc<spec::kActWordWidth>(write_data, spec::kActWordWidth*i);
+      if (table == 0)      breakpoint[half*kEntriesPerWrite + i] = data;
+      else if (table == 1) slope[half*kEntriesPerWrite + i]      = data;
+      else if (table == 2) offset[half*kEntriesPerWrite + i]     = data;
+    }
+  }
+
+  NVUINTW(write_width) LutRead(const NVUINT4 read_index) const {
+    NVUINTW(write_width) read_data = 0;
+    NVUINT1 half = nvhls::get_slc<1>(read_index, 0);
+    NVUINT3 table = nvhls::get_slc<3>(read_index, 1);
+    #pragma hls_unroll yes
+    for (int i = 0; i < kEntriesPerWrite; i++) {
+      spec::ActScalarType data = 0;
+      if (table == 0)      data = breakpoint[half*kEntriesPerWrite + i];
+      else if (table == 1) data = slope[half*kEntriesPerWrite + i];
+      else if (table == 2) data = offset[half*kEntriesPerWrite + i];
+      read_data.set_slc<spec::kActWordWidth>(spec::kActWordWidth*i, data);
+    }
+    return read_data;
+  }
+};
+
+// Decoded instruction, common to the 8-bit and the wide format
+class ActInst {
+ public:
+  NVUINT5             op;
+  NVUINT5             imm;   // LOOP body length - 1, JMP target
+  spec::Act::RegIndex dst;
+  spec::Act::RegIndex src1;
+  spec::Act::RegIndex src2;
+  spec::Act::RegIndex src3;  // EFMA addend
+  NVUINT2             flags;
+};
+
 class ActConfig {
   static const int write_width = 128;  
 
  public:
   NVUINT1                 is_valid;
   NVUINT1                 is_zero_first;
+  NVUINT1                 is_wide;  // 16-bit three-operand instructions
+  NVUINT1                 is_saturate; // EADD/EMUL/EFMA/ALUT clamp instead of wrap
   NVUINT6                 num_inst;
   NVUINT8                 num_output; // maximum is much larger than the required
   spec::Act::Address      buffer_addr_base;
   NVUINT8                 output_addr_base;
+  spec::Act::Param::VectorIndex param_addr_base;
+  NVUINT4                 param_stride; // 0 broadcasts the same parameters to every output
+  NVUINTW(spec::Act::kReduceScaleWidth) reduce_scale;
+  NVUINT1                 is_out_format; // 0: fixed Q4.4 output
+  NVUINT4                 out_frac;      // output fractional bits, 0 to 12 (clamped on write)
+  spec::ScalarType        out_zero_point;
   
-  NVUINT8                 inst_regs[spec::Act::kNumInstEntries];
+  NVUINT16                inst_regs[spec::Act::kNumInstEntries];
+  NVUINT8                 loop_count[spec::Act::kNumLoops]; // 0 behaves as 1
   // internal state 
   NVUINT5   inst_counter;
   NVUINT8   output_counter;
+  spec::Act::Param::VectorIndex param_counter; // LDPM count within the current output
+  spec::Act::Param::VectorIndex param_offset;  // output_counter*param_stride, kept as a running sum
+  NVUINT8   iter_offset;    // output_counter*loop_count[0], kept as a running sum
+  NVUINT1   is_iter_loop;   // a level 0 LOOP ran in this run, outputs own loop_count[0] vectors
+  NVUINT1               loop_active[spec::Act::kNumLoops];
+  spec::Act::InstIndex  loop_start[spec::Act::kNumLoops];
+  spec::Act::InstIndex  loop_end[spec::Act::kNumLoops];
+  NVUINT8               loop_iter[spec::Act::kNumLoops];
   
   
   ActConfig() {  
     Reset();
   }
   
-  NVUINT8 InstFetch(){
+  NVUINT4 GetOutFrac() const {
+    NVUINT4 frac = spec::Act::kActOutNumFrac;
+    if (is_out_format == 1) {
+      frac = out_frac;
+    }
+    return frac;
+  }
+
+  spec::ScalarType GetOutZeroPoint() const {
+    spec::ScalarType zero_point = 0;
+    if (is_out_format == 1) {
+      zero_point = out_zero_point;
+    }
+    return zero_point;
+  }
+
+  NVUINT16 InstFetch() const {
     return inst_regs[inst_counter];
   }
+
+  ActInst InstDecode() const {
+    NVUINT16 curr_inst = InstFetch();
+    ActInst inst;
+    if (is_wide == 1) {
+      inst.op    = nvhls::get_slc<5>(curr_inst, 11);
+      inst.dst   = nvhls::get_slc<3>(curr_inst, 8);
+      inst.src1  = nvhls::get_slc<3>(curr_inst, 5);
+      inst.src2  = nvhls::get_slc<3>(curr_inst, 2);
+      inst.src3  = inst.dst;
+      inst.flags = nvhls::get_slc<2>(curr_inst, 0);
+      inst.imm   = nvhls::get_slc<5>(curr_inst, 3);
+    }
+    else {
+      NVUINT2 a2 = nvhls::get_slc<2>(curr_inst, 2);
+      NVUINT2 a1 = nvhls::get_slc<2>(curr_inst, 0);
+      inst.op    = nvhls::get_slc<4>(curr_inst, 4);
+      inst.dst   = a2;
+      // A1 is only read by COPY and the binary ops (EFMA, EADD, EMUL)
+      if (inst.op == 0x5 || inst.op == 0x7 || inst.op == 0x8 || inst.op == 0x9) {
+        inst.src1 = a1;
+      }
+      else {
+        inst.src1 = a2;
+      }
+      inst.src2  = a2;
+      inst.src3  = 3;
+      inst.flags = 0;
+      inst.imm   = 0;
+    }
+    return inst;
+  }
+
+  spec::Act::Param::VectorIndex GetParamIndex() const {
+    return param_addr_base + param_offset + param_counter;
+  }
+
+  void ParamIncr() {
+    param_counter += 1;
+  }
+
+  // 0 behaves as 1
+  NVUINT8 GetLoopCount(const int level) const {
+    NVUINT8 count = loop_count[level];
+    if (count == 0) count = 1;
+    return count;
+  }
+
+  // Buffer and output index of the current iteration
+  NVUINT8 GetIterIndex() const {
+    NVUINT8 index = output_counter;
+    if (is_wide == 1 && is_iter_loop == 1) {
+      index = iter_offset + loop_iter[0];
+    }
+    return index;
+  }
+
+  void ClearLoop(const int level) {
+    loop_active[level] = 0;
+    loop_iter[level]   = 0;
+  }
+
+  // LOOP at inst_counter, body is the next body_len_m1+1 instructions
+  void LoopSetup(const spec::Act::RegIndex level, const NVUINT5 body_len_m1) {
+    #pragma hls_unroll yes
+    for (int l = 0; l < spec::Act::kNumLoops; l++) {
+      if (level == l) {
+        loop_active[l] = 1;
+        NVUINT7 end    = inst_counter + 1 + body_len_m1;
+        if (end > (num_inst-1)) end = num_inst - 1;
+        loop_start[l]  = inst_counter + 1;
+        loop_end[l]    = end;
+        loop_iter[l]   = 0;
+        if (l == 0) is_iter_loop = 1;
+      }
+    }
+  }
+
+  bool IsJumpTaken(const spec::Act::RegIndex cond) const {
+    bool is_last = (output_counter == (num_output-1));
+    bool is_taken;
+    switch (cond) {
+      case 0:  is_taken = 1; break;
+      case 1:  is_taken = (output_counter == 0); break;
+      case 2:  is_taken = is_last; break;
+      case 3:  is_taken = !is_last; break;
+      default: is_taken = 0; break;
+    }
+    return is_taken;
+  }
+
+  // Taken JMP, same end of pass as InstIncr when it leaves the last instruction.
+  // The JMP replaces the back edge of a loop ending on it and leaves any loop
+  // whose body does not hold the target, so no stale back edge can fire later
+  bool InstJump(const spec::Act::InstIndex target) {
+    bool is_end = 0;
+    #pragma hls_unroll yes
+    for (int l = 0; l < spec::Act::kNumLoops; l++) {
+      bool is_in_body = (target >= loop_start[l]) && (target <= loop_end[l]);
+      if (inst_counter == loop_end[l] || !is_in_body) {
+        ClearLoop(l);
+      }
+    }
+    if (inst_counter == (num_inst-1) || target >= num_inst) {
+      is_end = PassEnd();
+      if (!is_end && target < num_inst) {
+        inst_counter = target;
+      }
+    }
+    else {
+      inst_counter = target;
+    }
+    return is_end;
+  }
+
+  // Last instruction of an output done, move to the next output,
+  // loops never carry over into the next pass
+  bool PassEnd() {
+    bool is_end = 0;
+    inst_counter = 0;
+    param_counter = 0;
+    #pragma hls_unroll yes
+    for (int l = 0; l < spec::Act::kNumLoops; l++) {
+      ClearLoop(l);
+    }
+    if (output_counter == (num_output-1)) {    
+      output_counter = 0;
+      param_offset = 0;
+      iter_offset = 0;
+      is_iter_loop = 0;
+      is_zero_first = 0; // disactivate is_zero_first
+      is_end = 1;
+    }
+    else {
+      output_counter += 1;
+      param_offset += param_stride;
+      iter_offset += GetLoopCount(0);
+    }
+    return is_end;
+  }
   
   bool InstIncr() {
     bool is_end = 0;
-    if (inst_counter == (num_inst-1)) {
-      inst_counter = 0;
-      if (output_counter == (num_output-1)) {    
-        output_counter = 0;
-        is_zero_first = 0; // disactivate is_zero_first
-        is_end = 1;
+    bool is_loop = 0;
+    // Hardware loop back edge, inner level first; a finished inner loop
+    // falls through to an outer loop ending on the same instruction
+    #pragma hls_unroll yes
+    for (int l = 0; l < spec::Act::kNumLoops; l++) {
+      if (!is_loop && loop_active[l] == 1 && inst_counter == loop_end[l]) {
+        if (loop_count[l] <= 1 || loop_iter[l] == (loop_count[l]-1)) {
+          ClearLoop(l);
+        }
+        else {
+          loop_iter[l] += 1;
+          inst_counter = loop_start[l];
+          is_loop = 1;
+        }
+      }
+    }
+    if (!is_loop) {
+      if (inst_counter == (num_inst-1)) {
+        is_end = PassEnd();
       }
       else {
-        output_counter += 1;
+        inst_counter += 1;
       }
     }
-    else {
-      inst_counter += 1;
-    }
     return is_end;
   }
 
@@ -125,15 +468,37 @@ class ActConfig {
     ResetCounter();
     is_valid        = 0;
     is_zero_first   = 0;
+    is_wide         = 0;
+    is_saturate     = 0;
     num_inst        = 1;    // should be initialize to 1 to avoid error
     num_output      = 1;    // should be initialize to 1 to avoid error
     buffer_addr_base = 0;
     output_addr_base = 0;
-
+    param_addr_base = 0;
+    param_stride    = 0;
+    reduce_scale    = 0;
+    is_out_format   = 0;
+    out_frac        = spec::Act::kActOutNumFrac;
+    out_zero_point  = 0;
+    #pragma hls_unroll yes
+    for (int l = 0; l < spec::Act::kNumLoops; l++) {
+      loop_count[l] = 1;
+    }
   }
   void ResetCounter(){
     inst_counter    = 0;
     output_counter  = 0;  
+    param_counter   = 0;
+    param_offset    = 0;
+    iter_offset     = 0;
+    is_iter_loop    = 0;
+    #pragma hls_unroll yes
+    for (int l = 0; l < spec::Act::kNumLoops; l++) {
+      loop_active[l] = 0;
+      loop_start[l]  = 0;
+      loop_end[l]    = 0;
+      loop_iter[l]   = 0;
+    }
   }
   
   
@@ -142,10 +507,19 @@ class ActConfig {
     if (write_index == 0x01) {
       is_valid              = nvhls::get_slc<1>(write_data, 0);
       is_zero_first         = nvhls::get_slc<1>(write_data, 8);
+      is_wide               = nvhls::get_slc<1>(write_data, 16);
+      is_saturate           = nvhls::get_slc<1>(write_data, 17);
       num_inst              = nvhls::get_slc<6>(write_data, 24);
       num_output            = nvhls::get_slc<8>(write_data, 32);
       buffer_addr_base      = nvhls::get_slc<spec::Act::kAddressWidth>(write_data, 48);
       output_addr_base      = nvhls::get_slc<8>(write_data, 64);
+      param_addr_base       = nvhls::get_slc<spec::Act::Param::kVectorIndexWidth>(write_data, 80);
+      param_stride          = nvhls::get_slc<4>(write_data, 88);
+      reduce_scale          = nvhls::get_slc<spec::Act::kReduceScaleWidth>(write_data, 96);
+      is_out_format         = nvhls::get_slc<1>(write_data, 112);
+      out_frac              = nvhls::get_slc<4>(write_data, 116);
+      if (out_frac > spec::kActNumFrac) out_frac = spec::kActNumFrac;
+      out_zero_point        = nvhls::get_slc<spec::kIntWordWidth>(write_data, 120);
       
     }
     else if (write_index == 0x02) { // first 16 instructions
@@ -160,6 +534,19 @@ class ActConfig {
         inst_regs[i+16] = nvhls::get_slc<8>(write_data, 8*i);
       }
     }
+    else if (write_index >= 0x04 && write_index <= 0x07) { // 8 wide instructions each
+      NVUINT2 block = nvhls::get_slc<2>(write_index, 0);
+      #pragma hls_unroll yes
+      for (int i = 0; i < 8; i++) {
+        inst_regs[block*8 + i] = nvhls::get_slc<16>(write_data, 16*i);
+      }
+    }
+    else if (write_index == 0x08) { // hardware loop counts
+      #pragma hls_unroll yes
+      for (int l = 0; l < spec::Act::kNumLoops; l++) {
+        loop_count[l] = nvhls::get_slc<8>(write_data, 8*l);
+      }
+    }
   }
   
   NVUINTW(write_width) ActConfigRead(NVUINT8 read_index) const {
@@ -167,22 +554,43 @@ class ActConfig {
     if (read_index == 0x01) {
       read_data.set_slc<1>(0, is_valid);
       read_data.set_slc<1>(8, is_zero_first);
+      read_data.set_slc<1>(16, is_wide);
+      read_data.set_slc<1>(17, is_saturate);
       read_data.set_slc<6>(24, num_inst);
       read_data.set_slc<8>(32, num_output);
       read_data.set_slc<spec::Act::kAddressWidth>(48, buffer_addr_base);
       read_data.set_slc<8>(64, output_addr_base);
+      read_data.set_slc<spec::Act::Param::kVectorIndexWidth>(80, param_addr_base);
+      read_data.set_slc<4>(88, param_stride);
+      read_data.set_slc<spec::Act::kReduceScaleWidth>(96, reduce_scale);
+      read_data.set_slc<1>(112, is_out_format);
+      read_data.set_slc<4>(116, out_frac);
+      read_data.set_slc<spec::kIntWordWidth>(120, out_zero_point);
       
     }
     else if (read_index == 0x02) { // first 16 instructions
       #pragma hls_unroll yes
       for (int i = 0; i < 16; i++) {
-        read_data.set_slc<8>(8*i, inst_regs[i]);
+        read_data.set_slc<8>(8*i, nvhls::get_slc<8>(inst_regs[i], 0));
       }
     }
     else if (read_index == 0x03) { // second 16 instructions
       #pragma hls_unroll yes
       for (int i = 0; i < 16; i++) {
-        read_data.set_slc<8>(8*i, inst_regs[i+16]);
+        read_data.set_slc<8>(8*i, nvhls::get_slc<8>(inst_regs[i+16], 0));
+      }
+    }
+    else if (read_index >= 0x04 && read_index <= 0x07) { // 8 wide instructions each
+      NVUINT2 block = nvhls::get_slc<2>(read_index, 0);
+      #pragma hls_unroll yes
+      for (int i = 0; i < 8; i++) {
+        read_data.set_slc<16>(16*i, inst_regs[block*8 + i]);
+      }
+    }
+    else if (read_index == 0x08) { // hardware loop counts
+      #pragma hls_unroll yes
+      for (int l = 0; l < spec::Act::kNumLoops; l++) {
+        read_data.set_slc<8>(8*l, loop_count[l]);
       }
     }
     return read_data;
@@ -100,6 +100,7 @@ public:
   // LayerReduce  0: MaxPool, 1:MeanPool, 2: LayerAdd
   NVUINT3 mode;
   NVUINT1 is_rnn; // used to send collected RNN output back
+  NVUINT1 is_prefetch; // stream timestep t+1 into the PE input fill bank while t computes
   NVUINT3 memory_index_1;
   NVUINT3 memory_index_2;
   NVUINT8 num_vector_1;
@@ -115,6 +116,7 @@ public:
     is_valid       = 0;
     mode           = 0;
     is_rnn         = 0;
+    is_prefetch    = 0;
     memory_index_1 = 0;
     memory_index_2 = 0;
     num_vector_1   = 1;
@@ -131,6 +133,7 @@ public:
       is_valid       = nvhls::get_slc<1>(write_data, 0);
       mode           = nvhls::get_slc<3>(write_data, 8);
       is_rnn         = nvhls::get_slc<1>(write_data, 16);
+      is_prefetch    = nvhls::get_slc<1>(write_data, 24);
       memory_index_1 = nvhls::get_slc<3>(write_data, 32);
       memory_index_2 = nvhls::get_slc<3>(write_data, 40);
       num_vector_1   = nvhls::get_slc<8>(write_data, 48);
@@ -147,6 +150,7 @@ public:
       read_data.set_slc<1>(0, is_valid);
       read_data.set_slc<3>(8, mode);
       read_data.set_slc<1>(16, is_rnn);
+      read_data.set_slc<1>(24, is_prefetch);
       read_data.set_slc<3>(32, memory_index_1);
       read_data.set_slc<3>(40, memory_index_2);
       read_data.set_slc<8>(48, num_vector_1);
@@ -215,6 +219,10 @@ public:
     }
   }
 
+  bool IsLastTimestep() const {
+    return timestep_counter >= (num_timestep_1 - 1);
+  }
+
   void UpdateTimestepCounter(bool& is_end) {
     is_end = 0;
     if (timestep_counter >= (num_timestep_1 - 1)) {
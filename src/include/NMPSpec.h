@@ -49,6 +49,19 @@ namespace spec {
         AC_WRAP>
         UnsignedAccumType;
 
+    // Row statistics accumulate over up to 256 vectors, same fraction as AccumType
+    typedef ac_fixed<
+        kAttentionWordWidth + 16,
+        kAttentionNumInt + 12,
+        true,
+        AC_TRN,
+        AC_WRAP>
+        RowAccumType;
+    // Norm gamma/beta read from the GB as int8 Q2.6
+    const int kNmpParamNumFrac = 6;
+    typedef ac_fixed<kIntWordWidth, kIntWordWidth - kNmpParamNumFrac, true, AC_TRN, AC_WRAP>
+        ParamFixedType;
+
     // Vector definition as Matchlib vectors of size kVectorSize
     typedef nvhls::nv_scvector<FixedType, kVectorSize> VectorType;
     typedef nvhls::nv_scvector<UnsignedFixedType, kVectorSize>
@@ -73,8 +86,11 @@ namespace spec {
 
     public:
       NVUINT1 is_valid;
-      NVUINT3 mode;           // 0: RMSNorm, 1: Softmax
+      NVUINT3 mode;           // 0: RMSNorm, 1: Softmax, 2: LayerNorm, 3-7 rejected
+      NVUINT1 is_row;         // normalize over all num_vector_1 vectors of a timestep
+      NVUINT1 is_affine;      // norms: apply per-channel gamma/beta
       NVUINT3 memory_index_1; // target large-buffer index
+      NVUINT3 memory_index_2; // gamma at timestep 0, beta at timestep 1, by vector
       NVUINT8 num_vector_1;
       NVUINT16 num_timestep_1;
 
@@ -85,7 +101,10 @@ namespace spec {
       void Marshall(Marshaller<Size>& m) {
         m & is_valid;
         m & mode;
+        m & is_row;
+        m & is_affine;
         m & memory_index_1;
+        m & memory_index_2;
         m & num_vector_1;
         m & num_timestep_1;
         m & vector_counter;
@@ -95,7 +114,10 @@ namespace spec {
       void Reset() {
         is_valid       = 0;
         mode           = 0;
+        is_row         = 0;
+        is_affine      = 0;
         memory_index_1 = 0;
+        memory_index_2 = 0;
         num_vector_1   = 1;
         num_timestep_1 = 1;
         ResetCounter();
@@ -135,9 +157,16 @@ namespace spec {
         if (write_index == 0x01) {
           is_valid       = nvhls::get_slc<1>(write_data, 0);
           mode           = nvhls::get_slc<3>(write_data, 8);
+          is_row         = nvhls::get_slc<1>(write_data, 16);
+          is_affine      = nvhls::get_slc<1>(write_data, 24);
           memory_index_1 = nvhls::get_slc<3>(write_data, 32);
+          memory_index_2 = nvhls::get_slc<3>(write_data, 40);
           num_vector_1   = nvhls::get_slc<8>(write_data, 48);
           num_timestep_1 = nvhls::get_slc<16>(write_data, 64);
+          // Unused modes clear is_valid, so a following start is ignored
+          if (mode > 2) {
+            is_valid = 0;
+          }
         }
       }
 
@@ -147,7 +176,10 @@ namespace spec {
         if (read_index == 0x01) {
           read_data.set_slc<1>(0, is_valid);
           read_data.set_slc<3>(8, mode);
+          read_data.set_slc<1>(16, is_row);
+          read_data.set_slc<1>(24, is_affine);
           read_data.set_slc<3>(32, memory_index_1);
+          read_data.set_slc<3>(40, memory_index_2);
           read_data.set_slc<8>(48, num_vector_1);
           read_data.set_slc<16>(64, num_timestep_1);
         }
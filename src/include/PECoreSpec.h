@@ -40,6 +40,10 @@ namespace spec {
       typedef NVUINTW(kAddressWidth+1) AddressPlus1;
       typedef NVUINTW(kBankIndexSize) BankIndex;
       typedef NVUINTW(kLocalIndexSize) LocalIndex;
+      // Two partitions selected by the address MSB, one AXI region (16 bit local index) each,
+      // so the next layer can be loaded into one while the other is computed
+      const int kNumPartitions = 2;
+      const unsigned int kPartitionWidth = kAddressWidth - 1;
     }
     
     namespace Bias {
@@ -57,11 +61,43 @@ namespace spec {
       typedef NVUINTW(kLocalIndexSize) LocalIndex;
     }
     
+    namespace Scale {
+      // per output channel requantization multipliers (unsigned)
+      typedef nvhls::nv_scvector<NVUINT8, kNumVectorLanes> WordType;
+      const int kNumReadPorts = 1;
+      const int kNumWritePorts = 1;
+      const int kNumBanks = 1;
+      const int kEntriesPerBank = 256;       // need to configure
+      const unsigned int kAddressWidth = nvhls::index_width<kNumBanks * kEntriesPerBank>::val;
+      const unsigned int kBankIndexSize = nvhls::index_width<kNumBanks>::val;
+      const unsigned int kLocalIndexSize = nvhls::index_width<kEntriesPerBank>::val;
+      typedef NVUINTW(kAddressWidth) Address;
+      typedef NVUINTW(kAddressWidth+1) AddressPlus1;
+      typedef NVUINTW(kBankIndexSize) BankIndex;
+      typedef NVUINTW(kLocalIndexSize) LocalIndex;
+    }
+    
+    namespace Psum {
+      // partial sums spilled between K tiles, one entry per output row
+      typedef AccumVectorType WordType;
+      const int kNumReadPorts = 1;
+      const int kNumWritePorts = 1;
+      const int kNumBanks = 1;
+      const int kEntriesPerBank = 256;       // need to configure
+      const unsigned int kAddressWidth = nvhls::index_width<kNumBanks * kEntriesPerBank>::val;
+      const unsigned int kBankIndexSize = nvhls::index_width<kNumBanks>::val;
+      const unsigned int kLocalIndexSize = nvhls::index_width<kEntriesPerBank>::val;
+      typedef NVUINTW(kAddressWidth) Address;
+      typedef NVUINTW(kAddressWidth+1) AddressPlus1;
+      typedef NVUINTW(kBankIndexSize) BankIndex;
+      typedef NVUINTW(kLocalIndexSize) LocalIndex;
+    }
+    
     namespace Input {
       typedef VectorType WordType;
       const int kNumReadPorts = 1; // spec::kNumVectorLanes
       const int kNumWritePorts = 1;
-      const int kNumBanks = 1;
+      const int kNumBanks = 2;             // ping-pong: bank = address LSB
       const int kEntriesPerBank = 256;     // need to configure
       const unsigned int kAddressWidth = nvhls::index_width<kNumBanks * kEntriesPerBank>::val;
       const unsigned int kBankIndexSize = nvhls::index_width<kNumBanks>::val;
@@ -72,7 +108,10 @@ namespace spec {
       typedef NVUINTW(kLocalIndexSize) LocalIndex;
     }
     
-    const unsigned int kNumPEManagers = 1;
+    const unsigned int kNumPEManagers = 4;  // StreamType::index is 2 bits
+    const unsigned int kMaxNumBatch = 4;   // accumulator sets for weight-stationary batching
+    const unsigned int kZeroSkipWindow = 4; // zero input vectors skipped per cycle at most
+    const unsigned int kMaxStreamVectors = 256; // StreamType::logical_addr and the ActUnit output counter are 8 bits
   }
 }
 
@@ -82,6 +121,7 @@ template <unsigned int kAddressWidth>
 class PEManager {
   static const int kDebugLevel = 5;
   static const int write_width = spec::VectorType::width;
+  static const int kBaseWidth = 16;     // config field width of the base addresses
  public:  
   typedef NVUINTW(kAddressWidth)        Address;
   typedef NVUINTW(kAddressWidth+1)      AddressPlus1;
@@ -89,11 +129,30 @@ class PEManager {
   // FIXME: the naming adp"l"float_bias_weight contain typo
   
   NVUINT1   zero_active;                        // 8 (whether zero output functionality is activate)
+  // The partition replaces the weight address MSB, so a layer must fit in half the
+  // weight SRAM (1 << kPartitionWidth words from base_weight up), larger layers are
+  // rejected by PECore::CheckConfig instead of wrapping inside the partition
+  NVUINT1   weight_partition;                   // weight SRAM partition (address MSB) used by this manager
   NVUINT8   num_input;                          // 16
   Address   base_weight;                        // 16
   Address   base_bias;                          // 16
   Address   base_input;                         // 16
   
+  // Weight walk: block (output, input) is at output*stride_out + input*stride_in.
+  // stride_out = 0 means num_input and stride_in = 0 means 1 (row major default);
+  // with is_transpose each block is consumed transposed, e.g. stride_out = 1 and
+  // stride_in = number of block columns runs W^T from the layout stored for W
+  // (int8 and cluster blocks only, int4 with is_transpose is rejected)
+  NVUINT1   is_transpose;                       // 8
+  NVUINT8   stride_out;                         // 8
+  NVUINT8   stride_in;                          // 8
+  
+  // Requantization (separate register, see RequantWrite)
+  NVUINT8   accum_scale;                        // per layer multiplier
+  NVUINT5   accum_shift;                        // per layer right shift
+  NVUINT1   is_channel_scale;                   // take multiplier from scale SRAM per lane
+  NVUINT8   base_scale;                         // scale SRAM base for this manager
+  
   
   spec::ClusterType cluster_lut;                // 128
   
@@ -103,43 +162,118 @@ class PEManager {
   
   void Reset() {
     zero_active = 0;                      
+    weight_partition = 0;
     num_input = 1;    // avoid error                           
     base_weight = 0;                       
     base_bias = 0;                         
     base_input = 0;
+    is_transpose = 0;
+    stride_out = 0;
+    stride_in = 0;
+    accum_scale = spec::kAccumScale;
+    accum_shift = spec::kAccumShift;
+    is_channel_scale = 0;
+    base_scale = 0;
   }
   
+  // In cluster mode a 16x16 block is 8 words, base_weight must be 8 aligned
+  // so that the 8 reads land on distinct banks
   Address GetWeightAddr(Address input_index, Address output_index, bool is_cluster) const {
+    Address addr;
+    Address block = output_index * GetStrideOut() + input_index * GetStrideIn();
     if (is_cluster) { // read 8 banks (hard coded)
-      return (output_index*num_input+input_index)*8 + base_weight;
+      addr = block*8 + base_weight;
+    }
+    else {
+      addr = block*16 + base_weight;  
+    }
+    addr.set_slc<1>(kAddressWidth - 1, weight_partition);
+    return addr;
+  }
+  
+  // Whether the last weight word of a num_output row layer stays inside the partition
+  bool IsWeightInPartition(const NVUINT8 num_output, const bool is_cluster) const {
+    NVUINT8 last_output = num_output - 1;
+    NVUINT8 last_input = num_input - 1;
+    NVUINTW(17) last_block = last_output * GetStrideOut() + last_input * GetStrideIn();
+    NVUINTW(24) last_addr;
+    if (is_cluster) {
+      last_addr = last_block*8 + 7 + base_weight;
     }
     else {
-      return (output_index*num_input+input_index)*16 + base_weight;  
+      last_addr = last_block*16 + 15 + base_weight;
     }
+    return (last_addr >> spec::PE::Weight::kPartitionWidth) == 0;
+  }
+
+  NVUINT8 GetStrideOut() const {
+    return (stride_out == 0) ? num_input : stride_out;
+  }
+
+  NVUINT8 GetStrideIn() const {
+    NVUINT8 stride = stride_in;
+    if (stride_in == 0) stride = 1;
+    return stride;
   }
   
   Address GetBiasAddr(Address output_index) const {
     return output_index + base_bias;
   }
+
+  Address GetScaleAddr(Address output_index) const {
+    return output_index + base_scale;
+  }
   
-  Address GetInputAddr(Address input_index) const{
-    return input_index + base_input;
+  // In ping-pong mode the two input banks are interleaved on the address LSB,
+  // so filling one bank never collides with the MAC read of the other
+  Address GetInputAddr(Address input_index, NVUINT1 bank, bool is_pingpong) const{
+    if (is_pingpong) {
+      Address addr = input_index + base_input;
+      return (addr << 1) + bank;
+    }
+    else {
+      return input_index + base_input;
+    }
   }
   
   void PEManagerWrite(const NVUINTW(write_width)& write_data) {
     zero_active             = nvhls::get_slc<1>(write_data, 0);
+    weight_partition        = nvhls::get_slc<1>(write_data, 4);
     num_input               = nvhls::get_slc<8>(write_data, 8);  
-    base_weight             = nvhls::get_slc<kAddressWidth>(write_data, 16);  
-    base_bias               = nvhls::get_slc<kAddressWidth>(write_data, 32);  
-    base_input              = nvhls::get_slc<kAddressWidth>(write_data, 48);  
+    base_weight             = nvhls::get_slc<kBaseWidth>(write_data, 16);  
+    base_bias               = nvhls::get_slc<kBaseWidth>(write_data, 32);  
+    base_input              = nvhls::get_slc<kBaseWidth>(write_data, 48);  
+    is_transpose            = nvhls::get_slc<1>(write_data, 64);
+    stride_out              = nvhls::get_slc<8>(write_data, 72);
+    stride_in               = nvhls::get_slc<8>(write_data, 80);
   }
 
   void PEManagerRead(NVUINTW(write_width)& read_data) const {
+    read_data = 0;
     read_data.set_slc<1>(0, zero_active);
+    read_data.set_slc<1>(4, weight_partition);
     read_data.set_slc<8>(8, num_input);
-    read_data.set_slc<kAddressWidth>(16, base_weight);
-    read_data.set_slc<kAddressWidth>(32, base_bias);
-    read_data.set_slc<kAddressWidth>(48, base_input);
+    read_data.set_slc<kBaseWidth>(16, nvhls::get_slc<kBaseWidth>(base_weight, 0));
+    read_data.set_slc<kBaseWidth>(32, nvhls::get_slc<kBaseWidth>(base_bias, 0));
+    read_data.set_slc<kBaseWidth>(48, nvhls::get_slc<kBaseWidth>(base_input, 0));
+    read_data.set_slc<1>(64, is_transpose);
+    read_data.set_slc<8>(72, stride_out);
+    read_data.set_slc<8>(80, stride_in);
+  }
+
+  void RequantWrite(const NVUINTW(write_width)& write_data) {
+    accum_scale             = nvhls::get_slc<8>(write_data, 0);
+    accum_shift             = nvhls::get_slc<5>(write_data, 8);
+    is_channel_scale        = nvhls::get_slc<1>(write_data, 16);
+    base_scale              = nvhls::get_slc<8>(write_data, 24);
+  }
+
+  void RequantRead(NVUINTW(write_width)& read_data) const {
+    read_data = 0;
+    read_data.set_slc<8>(0, accum_scale);
+    read_data.set_slc<5>(8, accum_shift);
+    read_data.set_slc<1>(16, is_channel_scale);
+    read_data.set_slc<8>(24, base_scale);
   }
 
   void ClusterWrite(const NVUINTW(write_width)& write_data) {
@@ -155,18 +289,34 @@ class PEManager {
  
 /*** XXX XXX IMPORTANT!!!!! make sure this part (and the ClusterLookup() ) is correctly synthesized ***/
 /*** XXX XXX PLEASE also try to figure out if clustering actually can save energy                   ***/
+  // indices are raw 4-bit LUT entries, read them unsigned (HalfType is signed)
   spec::VectorType ClusterLookup(const spec::HalfVectorType indices) const {
     spec::VectorType out;
 
     #pragma hls_unroll yes
     for (int i = 0; i < spec::kNumVectorLanes; i++) {
-      out[i] = cluster_lut[indices[i]];
-    
+      NVUINT4 lut_index = nvhls::get_slc<4>(indices[i], 0);
+      out[i] = cluster_lut[lut_index];
     }
     return out;
   }
+
+  // A cluster weight word packs two 16x4b index rows: row 2k in [63:0], row 2k+1 in [127:64]
+  void ClusterExpand(const spec::VectorType& word, spec::VectorType& row_lo, spec::VectorType& row_hi) const {
+    NVUINTW(write_width) bits = word.to_rawbits();
+    spec::HalfVectorType indices_lo, indices_hi;
+    indices_lo = nvhls::get_slc<spec::HalfVectorType::width>(bits, 0);
+    indices_hi = nvhls::get_slc<spec::HalfVectorType::width>(bits, spec::HalfVectorType::width);
+    row_lo = ClusterLookup(indices_lo);
+    row_hi = ClusterLookup(indices_hi);
+  }
 };
 
+// A config is checked against the manager registers on every region 0x4 write
+// (PECore::CheckConfig): batch sizes, weights that must fit in the manager's
+// partition (half the weight SRAM), K-tiled rows that must fit in the psum
+// SRAM, no K-tiling in batch mode, no int4 cluster weights and no transpose
+// in int4 mode, a rejected config reads back is_valid = 0
 class PEConfig {
   static const int write_width = spec::VectorType::width;
 
@@ -176,20 +326,58 @@ class PEConfig {
   NVUINT1   is_zero_first;
   NVUINT1   is_cluster;
   NVUINT1   is_bias;
-  NVUINT4   num_manager;      // number of matrix-vector mul (1 or 2)
-  NVUINT8   num_output;       // number of output vector per matrix vector mul (For LSTM it should be 4*num_output in act unit) 
-  
-  // Counters 
+  NVUINT4   num_manager;      // number of matrix-vector mul (1 to kNumPEManagers, clamped on write)
+  NVUINT8   num_output;       // number of output vector per matrix vector mul (For LSTM it should be 4*num_output in act unit)
+  NVUINT1   is_input_pingpong; // double buffered input SRAM, input_port fills one bank while MAC reads the other
+  // Batch mode: the B = num_batch tokens are one GB timestep of B*num_input vectors
+  // (token b at logical address b*num_input + i) and act_port emits B vectors per
+  // output row ordered by token, so the ActUnit runs B*num_output outputs and token b
+  // of row o lands at vector o*B + b of one GB timestep. Configs that need more than
+  // kMaxStreamVectors vectors on either side are rejected (see PECore::CheckConfig).
+  NVUINT3   num_batch;        // tokens sharing one weight fetch (1 to kMaxNumBatch, 0 behaves as 1)
+  NVUINT1   is_zero_skip;     // skip MAC cycles of all-zero input vectors (not in batch mode)
+  NVUINT1   is_int4;          // weight and input words pack 32 int4 values (rejected in cluster mode)
+  // K-tiling: a reduction longer than num_input runs as several start pulses,
+  // partial sums are kept in the psum SRAM between them (rejected in batch mode).
+  // One psum entry per output row, so num_output*num_manager must fit in the
+  // psum SRAM (rejected by PECore::CheckConfig otherwise). PEConfig is rewritten
+  // between tiles to flip these bits: that is only safe once the previous tile
+  // has finished (PECore back in IDLE), the write restarts the row counters,
+  // which are all zero at that point, and keeps input_bank.
+  NVUINT1   is_accum_load;    // start each output row from its spilled partial sum
+  NVUINT1   is_accum_store;   // spill the output row instead of sending it to act_port
+
+  // Counters
  protected:
   NVUINT4   manager_counter;
   NVUINT8   input_counter;
   NVUINT8   output_counter;
- 
- public: 
-  PEConfig() {  
+  NVUINT3   batch_counter;
+  NVUINT1   input_bank;       // input bank read by MAC (ping-pong only), the other one is filled,
+                              // kept across PEConfig writes so a prefetched bank survives a
+                              // config write between layers, only Reset clears it
+
+ public:
+  PEConfig() {
     Reset();
-  }  
-  
+  }
+
+  NVUINT1 InputBank() const {
+    return input_bank;
+  }
+
+  NVUINT1 FillBank() const {
+    NVUINT1 fill_bank = input_bank ^ 1;
+    return fill_bank;
+  }
+
+  // swap on start, the filled bank becomes the one MAC reads
+  void SwapInputBank() {
+    if (is_input_pingpong) {
+      input_bank = FillBank();
+    }
+  }
+
   NVUINT4 ManagerIndex() const {
     return manager_counter;
   }
@@ -201,6 +389,10 @@ class PEConfig {
   NVUINT8 OutputIndex() const {
     return output_counter;
   }  
+
+  NVUINT3 BatchIndex() const {
+    return batch_counter;
+  }
   
   void Reset() {
     is_valid      = 0;
@@ -210,14 +402,22 @@ class PEConfig {
     is_bias       = 0;
     num_manager    = 1;   // should be initialize to 1 to avoid error
     num_output    = 1;    // should be initialize to 1 to avoid error
-    
+    is_input_pingpong = 0;
+    num_batch     = 1;
+    is_zero_skip  = 0;
+    is_int4       = 0;
+    is_accum_load = 0;
+    is_accum_store = 0;
+
+    input_bank    = 0;
     ResetCounter();
   }
-  
+
   void ResetCounter() {
     manager_counter = 0;
     input_counter  = 0;
-    output_counter = 0;  
+    output_counter = 0;
+    batch_counter  = 0;
   }
   
   // note that since num_input is in PEManager, needs a const parameter input
@@ -240,6 +440,53 @@ class PEConfig {
     }
   }
   
+  bool IsInt4() const {
+    return is_int4;
+  }
+
+  bool IsAccumLoad() const {
+    return is_accum_load;
+  }
+
+  bool IsAccumStore() const {
+    return is_accum_store;
+  }
+
+  // Sequence number of the output row inside a timestep (psum SRAM address),
+  // wide enough for num_output*num_manager rows so an oversized layer cannot wrap
+  NVUINT12 RowIndex() const {
+    return output_counter * num_manager + manager_counter;
+  }
+
+  bool IsZeroSkip() const {
+    return is_zero_skip && (num_batch <= 1);
+  }
+
+  // Jump over skip_count zero input vectors found by the look-ahead
+  void SkipInputCounter(const NVUINT16 num_input, const NVUINT8 skip_count, bool& is_input_end) {
+    is_input_end = 0;
+    NVUINT16 next_counter = input_counter + skip_count;
+    if (next_counter >= num_input) {
+      input_counter = 0;
+      is_input_end  = 1;
+    }
+    else {
+      input_counter = next_counter;
+    }
+  }
+
+  // Used after each token of a batch (MAC or OUT), weights are reused across the batch
+  void UpdateBatchCounter(bool& is_batch_end) {
+    is_batch_end = 0;
+    if (batch_counter >= (num_batch - 1)) {
+      batch_counter = 0;
+      is_batch_end  = 1;
+    }
+    else {
+      batch_counter += 1;
+    }
+  }
+
   // used after bias appending (a vector row of mul is done)
   void UpdateManagerCounter(bool& is_output_end) {
     is_output_end = 0;
@@ -270,7 +517,16 @@ class PEConfig {
     is_cluster            = nvhls::get_slc<1>(write_data, 16);
     is_bias               = nvhls::get_slc<1>(write_data, 24);
     num_manager           = nvhls::get_slc<4>(write_data, 32);
+    if (num_manager == 0) num_manager = 1;
+    if (num_manager > spec::PE::kNumPEManagers) num_manager = spec::PE::kNumPEManagers;
     num_output            = nvhls::get_slc<8>(write_data, 40);
+    is_input_pingpong     = nvhls::get_slc<1>(write_data, 48);
+    num_batch             = nvhls::get_slc<3>(write_data, 56);
+    if (num_batch > spec::PE::kMaxNumBatch) num_batch = spec::PE::kMaxNumBatch;
+    is_zero_skip          = nvhls::get_slc<1>(write_data, 64);
+    is_int4               = nvhls::get_slc<1>(write_data, 72);
+    is_accum_load         = nvhls::get_slc<1>(write_data, 80);
+    is_accum_store        = nvhls::get_slc<1>(write_data, 88);
   }
 
   void PEConfigRead(NVUINTW(write_width)& read_data) const {
@@ -281,7 +537,13 @@ class PEConfig {
     read_data.set_slc<1>(16, is_cluster);
     read_data.set_slc<1>(24, is_bias);
     read_data.set_slc<4>(32, num_manager);
-    read_data.set_slc<8>(40, num_output); 
+    read_data.set_slc<8>(40, num_output);
+    read_data.set_slc<1>(48, is_input_pingpong);
+    read_data.set_slc<3>(56, num_batch);
+    read_data.set_slc<1>(64, is_zero_skip);
+    read_data.set_slc<1>(72, is_int4);
+    read_data.set_slc<1>(80, is_accum_load);
+    read_data.set_slc<1>(88, is_accum_store);
   }
 };
 
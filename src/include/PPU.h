@@ -40,32 +40,133 @@
 
 #pragma hls_design ccore
 #pragma hls_ccore_type combinational
-inline void EAdd (const spec::ActVectorType in1, const spec::ActVectorType in2, spec::ActVectorType& out) 
+inline void EAdd (const spec::ActVectorType in1, const spec::ActVectorType in2, const bool is_sat, spec::ActVectorType& out) 
 {
   spec::ActVectorType out_tmp;   
   #pragma hls_unroll yes
   for (int i = 0; i < spec::kNumVectorLanes; i++) {  
     ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> a, b, c;
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true, AC_TRN, AC_SAT> c_sat;
     a.set_slc(0, in1[i]);
     b.set_slc(0, in2[i]);
-    c = a + b;
-    out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
+    ac_fixed<spec::kActWordWidth + 1, spec::kActWordWidth - spec::kActNumFrac + 1, true> sum = a + b;
+    c = sum;      // wraps on overflow
+    c_sat = sum;  // clamps to the Q4.12 range
+    if (is_sat) out_tmp[i] = c_sat.template slc<spec::kActWordWidth>(0);
+    else out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
   }
   out = out_tmp;
 }  
 
 #pragma hls_design ccore
 #pragma hls_ccore_type combinational
-inline void EMul (const spec::ActVectorType in1, const spec::ActVectorType in2, spec::ActVectorType& out) 
+inline void EMul (const spec::ActVectorType in1, const spec::ActVectorType in2, const bool is_sat, spec::ActVectorType& out) 
 {
   spec::ActVectorType out_tmp;   
   #pragma hls_unroll yes
   for (int i = 0; i < spec::kNumVectorLanes; i++) {  
     ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> a, b, c;
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true, AC_TRN, AC_SAT> c_sat;
     a.set_slc(0, in1[i]);
     b.set_slc(0, in2[i]);
-    c = a * b; // Automatically handles Q4.12 * Q4.12 -> Q8.24 -> aligns back to Q4.12
-    out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
+    ac_fixed<spec::kActWordWidth * 2, (spec::kActWordWidth - spec::kActNumFrac) * 2, true> prod = a * b;
+    c = prod;     // Q4.12 * Q4.12 -> Q8.24 -> aligns back to Q4.12, wraps on overflow
+    c_sat = prod; // clamps to the Q4.12 range
+    if (is_sat) out_tmp[i] = c_sat.template slc<spec::kActWordWidth>(0);
+    else out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
+  }
+  out = out_tmp;
+}
+
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void EFma (const spec::ActVectorType in1, const spec::ActVectorType in2, const spec::ActVectorType in3, const bool is_sat, spec::ActVectorType& out) 
+{
+  spec::ActVectorType out_tmp;   
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {  
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> a, b, d, c;
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true, AC_TRN, AC_SAT> c_sat;
+    a.set_slc(0, in1[i]);
+    b.set_slc(0, in2[i]);
+    d.set_slc(0, in3[i]);
+    // Q8.24 product and sum are kept at full precision, quantized to Q4.12 only once
+    ac_fixed<spec::kActWordWidth * 2 + 1, (spec::kActWordWidth - spec::kActNumFrac) * 2 + 1, true> prod_sum = a * b + d;
+    c = prod_sum;
+    c_sat = prod_sum;
+    if (is_sat) out_tmp[i] = c_sat.template slc<spec::kActWordWidth>(0);
+    else out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
+  }
+  out = out_tmp;
+}
+
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void HSum (const spec::ActVectorType in, const bool is_square, spec::Act::ReduceType& out) 
+{
+  spec::Act::ReduceType sum = 0;
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {  
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> a;
+    a.set_slc(0, in[i]);
+    ac_fixed<spec::kActWordWidth * 2, (spec::kActWordWidth - spec::kActNumFrac) * 2, true> term;
+    if (is_square) term = a * a;
+    else term = a;
+    sum += term;
+  }
+  out = sum;
+}
+
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void HMax (const spec::ActVectorType in, spec::Act::ReduceType& out) 
+{
+  spec::ActScalarType max_val = in[0];
+  #pragma hls_unroll yes
+  for (int i = 1; i < spec::kNumVectorLanes; i++) {  
+    if (in[i] > max_val) max_val = in[i];
+  }
+  ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> a;
+  a.set_slc(0, max_val);
+  out = a;
+}
+
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void HBroadcast (const spec::Act::ReduceType in, const NVUINTW(spec::Act::kReduceScaleWidth) scale, const bool is_scale, spec::ActVectorType& out) 
+{
+  ac_fixed<spec::Act::kReduceScaleWidth + 1, 1, false> scale_ac;
+  if (is_scale && scale != 0) {
+    scale_ac = 0;
+    scale_ac.set_slc(0, scale);
+  }
+  else {
+    scale_ac = 1;
+  }
+  ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true, AC_TRN, AC_SAT> c = in * scale_ac;
+  spec::ActScalarType c_raw = c.template slc<spec::kActWordWidth>(0);
+  spec::ActVectorType out_tmp;   
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {  
+    out_tmp[i] = c_raw;
+  }
+  out = out_tmp;
+}
+
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void Sigmoid (const spec::ActVectorType in, spec::ActVectorType& out)
+{
+  spec::ActVectorType out_tmp;
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> in_ac;
+    in_ac.set_slc(0, in[i]);
+    ac_fixed<spec::kActWordWidth, 1, false> out_ac;
+    ac_math::ac_sigmoid_pwl(in_ac, out_ac);
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> result;
+    result = out_ac;
+    out_tmp[i] = result.template slc<spec::kActWordWidth>(0);
   }
   out = out_tmp;
 }
@@ -88,6 +189,33 @@ inline void Tanh (const spec::ActVectorType in, spec::ActVectorType& out)
   out = out_tmp;
 }
 
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void ActLutEval (const spec::ActVectorType in, const ActLut lut, const bool is_sat, spec::ActVectorType& out)
+{
+  spec::ActVectorType out_tmp;
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    // Breakpoints ascend, so the last one passed selects the segment
+    NVUINTW(nvhls::index_width<spec::Act::kNumLutSegments>::val) seg = 0;
+    #pragma hls_unroll yes
+    for (int k = 1; k < spec::Act::kNumLutSegments; k++) {
+      if (in[i] >= lut.breakpoint[k]) seg = k;
+    }
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> x, m, b, c;
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true, AC_TRN, AC_SAT> c_sat;
+    x.set_slc(0, in[i]);
+    m.set_slc(0, lut.slope[seg]);
+    b.set_slc(0, lut.offset[seg]);
+    ac_fixed<spec::kActWordWidth * 2 + 1, (spec::kActWordWidth - spec::kActNumFrac) * 2 + 1, true> y = m * x + b;
+    c = y;      // wraps on overflow
+    c_sat = y;  // clamps to the Q4.12 range
+    if (is_sat) out_tmp[i] = c_sat.template slc<spec::kActWordWidth>(0);
+    else out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
+  }
+  out = out_tmp;
+}
+
 #pragma hls_design ccore
 #pragma hls_ccore_type combinational
 inline void Relu (const spec::ActVectorType in, spec::ActVectorType& out) 
@@ -101,6 +229,21 @@ inline void Relu (const spec::ActVectorType in, spec::ActVectorType& out)
   out = out_tmp;
 }  
 
+#pragma hls_design ccore
+#pragma hls_ccore_type combinational
+inline void OneMinus (const spec::ActVectorType in, spec::ActVectorType& out)
+{
+  spec::ActVectorType out_tmp;
+  #pragma hls_unroll yes
+  for (int i = 0; i < spec::kNumVectorLanes; i++) {
+    ac_fixed<spec::kActWordWidth, spec::kActWordWidth - spec::kActNumFrac, true> a, c;
+    a.set_slc(0, in[i]);
+    c = 1 - a; // 1-x complements a sigmoid gate, e.g. (1-z) in a GRU update
+    out_tmp[i] = c.template slc<spec::kActWordWidth>(0);
+  }
+  out = out_tmp;
+}
+
 #pragma hls_design ccore
 #pragma hls_ccore_type combinational
 inline void Silu (const spec::ActVectorType in, spec::ActVectorType& out) 
@@ -57,7 +57,7 @@ namespace spec {
   const int kActWordMin = -kActWordMax;
   typedef NVINTW(kActWordWidth) ActScalarType;
   typedef typename nvhls::nv_scvector<ActScalarType, kNumVectorLanes> ActVectorType;
-  const int kNumActEntries =  4;
+  const int kNumActEntries =  8;
 
   const int rvaBytes = (kVectorSize * kIntWordWidth) / 8;   
 